@@ -0,0 +1,70 @@
+#pragma once
+#include "tokens.h"
+#include "reducer.h"
+#include "window.h"
+#include <vector>
+#include <map>
+#include <string>
+
+// Вычисление выражения сразу для множества строк. RPN компилируется в список
+// инструкций, каждая инструкция применяется к блоку из kBlockSize строк
+// (циклы по массивам векторизуются компилятором), блоки делятся между потоками.
+// Деление на ноль дает ошибку, только если строка с ним попала в результат
+// (как в Evaluator): if(x == 0, 0, y / x) безопасно.
+// С оконными функциями блоки идут по порядку в одном потоке, а состояние окон
+// сохраняется между вызовами: длинный ряд можно подавать порциями
+class BatchEvaluator {
+public:
+    static constexpr size_t kBlockSize = 256;
+
+    // Скаляр, одинаковый для всех строк
+    void setVariable(const std::string& name, double value);
+    // Столбец значений: data[row], должен жить до конца вычисления
+    void setColumn(const std::string& name, const double* data);
+    // Забыть состояние оконных функций перед новым рядом. Как и в Evaluator,
+    // другое выражение начинает ряд заново
+    void resetState();
+
+    void evaluateRPN(const std::vector<Token>& rpnTokens, size_t rows,
+                     double* out, unsigned threads = 1);
+    // Свертка результатов без материализации выходного столбца
+    void reduceRPN(const std::vector<Token>& rpnTokens, size_t rows,
+                   Accumulator& accumulator, unsigned threads = 1);
+
+private:
+    enum class Op {
+        Constant, Column,
+        Add, Sub, Mul, Div, Pow,
+        Less, LessEqual, Greater, GreaterEqual, Equal, NotEqual, And, Or,
+        Negate, Not, Sin, Cos, Factorial,
+        Select, Window
+    };
+
+    struct Instruction {
+        Op op;
+        double value = 0;
+        const double* column = nullptr;
+        WindowState* window = nullptr;
+    };
+
+    struct Program {
+        std::vector<Instruction> code;
+        size_t depth = 0;
+        bool stateful = false;
+        bool divides = false; // Нужны ли флаги деления на ноль
+    };
+
+    Program compile(const std::vector<Token>& rpnTokens);
+    static void evaluateBlock(const Program& program, size_t begin, size_t count,
+                              std::vector<double>& stack,
+                              std::vector<unsigned char>& divisionByZero);
+
+    template <typename Consume>
+    static void run(const Program& program, size_t rows, unsigned threads,
+                    Consume&& consume);
+
+    std::map<std::string, double> variables_;
+    std::map<std::string, const double*> columns_;
+    std::map<size_t, WindowState> windows_; // По позиции функции в RPN
+    std::vector<Token> windowsProgram_;     // Выражение, которому принадлежат окна
+};
@@ -1,7 +1,12 @@
 #pragma once
 
+#include "batch_evaluator.h"
 #include "error.h"
 #include "evaluator.h"
+#include "grammar.h"
 #include "lexer.h"
 #include "parser.h"
-#include "tokens.h"
\ No newline at end of file
+#include "reducer.h"
+#include "static_expression.h"
+#include "tokens.h"
+#include "window.h"
\ No newline at end of file
@@ -1,5 +1,6 @@
 #pragma once
 #include "tokens.h"
+#include "window.h"
 #include <vector>
 #include <stack>
 #include <map>
@@ -9,11 +10,28 @@ class Evaluator {
 public:
     void setVariable(const std::string& name, double value);
     double evaluateRPN(const std::vector<Token>& rpnTokens);
+    // Оконные функции (rolling_mean, lag, ...) помнят предыдущие вызовы
+    // evaluateRPN: одна строка ряда - один вызов. Сброс перед новым рядом.
+    // Другое выражение тоже начинает ряд заново, смена параметра окна
+    // посреди ряда - RuntimeError
+    void resetState();
 
 private:
+    // Деление на ноль не прерывает вычисление сразу: результат помечается,
+    // а ошибка возникает, только если помеченное значение дошло до ответа
+    // (ветвь, отброшенная if, ошибки не дает)
+    struct Operand {
+        double value;
+        bool divisionByZero = false;
+    };
+
     void processOperator(const Token& token);
     void processFunction(const Token& token);
+    void processConditional(const Token& token);
+    void processWindow(const Token& token, size_t site);
 
-    std::stack<double> operandStack_;
+    std::stack<Operand> operandStack_;
     std::map<std::string, double> variables_;
+    std::map<size_t, WindowState> windows_; // По позиции функции в RPN
+    std::vector<Token> windowsProgram_;     // Выражение, которому принадлежат окна
 };
\ No newline at end of file
@@ -0,0 +1,48 @@
+#pragma once
+#include <cstddef>
+#include <string_view>
+
+// Приоритеты операторов и функций. Таблица constexpr, чтобы ее использовали
+// и Parser, и разбор выражений во время компиляции (static_expression.h)
+struct Precedence {
+    std::string_view lexeme;
+    int level;
+};
+
+inline constexpr Precedence kPrecedenceTable[] = {
+    {"unary_minus", 10},
+    {"!", 9}, {"sin", 9}, {"cos", 9}, {"not", 9}, {"if", 9},
+    {"rolling_mean", 9}, {"rolling_min", 9}, {"rolling_max", 9}, {"lag", 9}, {"ema", 9},
+    {"^", 8},
+    {"*", 7}, {"/", 7},
+    {"+", 6}, {"-", 6},
+    {"<", 5}, {"<=", 5}, {">", 5}, {">=", 5},
+    {"==", 4}, {"!=", 4},
+    {"&&", 3},
+    {"||", 2},
+};
+
+// 0 - не оператор (скобки, запятая)
+constexpr int precedenceOf(std::string_view lexeme) {
+    for (const auto& entry : kPrecedenceTable) {
+        if (entry.lexeme == lexeme) return entry.level;
+    }
+    return 0;
+}
+
+constexpr bool isLeftAssociativeOperator(std::string_view lexeme) {
+    return lexeme != "^" && lexeme != "!";
+}
+
+// Оконные функции f(x, параметр): хранят состояние между строками
+constexpr bool isWindowFunction(std::string_view lexeme) {
+    return lexeme == "rolling_mean" || lexeme == "rolling_min" || lexeme == "rolling_max" ||
+           lexeme == "lag" || lexeme == "ema";
+}
+
+// Число аргументов в записи f(a, b, ...)
+constexpr size_t functionArity(std::string_view lexeme) {
+    if (lexeme == "if") return 3;
+    if (isWindowFunction(lexeme)) return 2;
+    return 1;
+}
@@ -2,19 +2,37 @@
 #include "tokens.h"
 #include <vector>
 #include <string>
+#include <string_view>
+#include <istream>
 
 class Lexer {
 public:
     std::vector<Token> tokenize(const std::string& input);
 
+    // Потоковый режим: токены выдаются по одному через next(),
+    // вход читается из потока блоками фиксированного размера
+    void reset(std::istream& input);
+    void reset(std::string_view input);
+    bool next(Token& token);
+
 private:
+    static constexpr size_t kChunkSize = 64 * 1024;
+
+    int peek();
+    void advance();
+    bool fill();
+    void emit(Token&& token, Token& out);
+
     void skipWhitespace();
-    void tokenizeNumber();
-    void tokenizeIdentifier();
-    void tokenizeOperator();
-    void tokenizeBracket();
+    void tokenizeNumber(Token& out);
+    void tokenizeIdentifier(Token& out);
+    void tokenizeOperator(Token& out);
+    void tokenizeBracket(Token& out);
 
-    const std::string* input_;
+    std::istream* stream_ = nullptr;
+    std::string chunk_;
+    std::string_view input_;
     size_t pos_ = 0;
-    std::vector<Token> tokens_;
-};
\ No newline at end of file
+    bool hasLast_ = false;
+    TokenType lastType_ = TokenType::Number;
+};
@@ -1,5 +1,6 @@
 #pragma once
 #include "tokens.h"
+#include "lexer.h"
 #include <vector>
 #include <stack>
 #include <map>
@@ -8,15 +9,24 @@ class Parser {
 public:
     std::vector<Token> parseToRPN(const std::vector<Token>& tokens);
 
+    // Конвейерный разбор: токены берутся из лексера по одному,
+    // промежуточный вектор токенов не строится
+    std::vector<Token> parseToRPN(Lexer& lexer);
+    std::vector<Token> parseToRPN(std::istream& input);
+
 private:
     int getPrecedence(const Token& token);
     bool isLeftAssociative(const Token& token);
-    void handleOperator(const Token& token);
-    void handleFunction(const Token& token);
-    void handleLeftBracket(const Token& token);
+    void handleOperator(Token&& token);
+    void handleFunction(Token&& token);
+    void handleLeftBracket(Token&& token);
     void handleRightBracket(const Token& token);
+    void handleComma();
+    void handleToken(Token&& token);
+    void begin();
+    std::vector<Token> finish();
 
     std::vector<Token> output_;
     std::stack<Token> stack_;
-    const std::vector<Token>* tokens_ = nullptr;
+    std::stack<size_t> arguments_; // Число аргументов в каждой открытой скобке
 };
\ No newline at end of file
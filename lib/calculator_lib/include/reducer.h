@@ -0,0 +1,53 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <cstddef>
+
+// Какие агрегаты нужны: "sum,min,max,mean,hist:64" или "hist:64:0:1"
+struct ReduceSpec {
+    bool sum = false;
+    bool min = false;
+    bool max = false;
+    bool mean = false;
+    size_t histBins = 0;
+    bool histRange = false; // Диапазон гистограммы задан явно
+    double histLow = 0;
+    double histHigh = 0;
+
+    static ReduceSpec parse(const std::string& spec);
+};
+
+// Аккумулятор свертки: значения добавляются блоками, аккумуляторы потоков
+// объединяются через merge(). Сумма компенсированная (Ноймайер), поэтому
+// результат практически не зависит от числа потоков и порядка слияния.
+// Считаются только агрегаты из spec (mean включает сумму), count - всегда
+class Accumulator {
+public:
+    explicit Accumulator(const ReduceSpec& spec = ReduceSpec());
+
+    void add(const double* values, size_t count);
+    void merge(const Accumulator& other);
+
+    size_t count() const { return count_; }
+    double sum() const { return sum_ + compensation_; }
+    double min() const { return min_; }
+    double max() const { return max_; }
+    double mean() const;
+
+    const ReduceSpec& spec() const { return spec_; }
+    const std::vector<size_t>& histogram() const { return histogram_; }
+    size_t outOfRange() const { return outOfRange_; }
+
+private:
+    void addSum(double value);
+
+    ReduceSpec spec_;
+    size_t count_ = 0;
+    double sum_ = 0;
+    double compensation_ = 0;
+    double min_;
+    double max_;
+
+    std::vector<size_t> histogram_;
+    size_t outOfRange_ = 0;
+};
@@ -0,0 +1,502 @@
+#pragma once
+#include "error.h"
+#include "grammar.h"
+#include "tokens.h"
+#include <cmath>
+#include <cstddef>
+#include <string_view>
+#include <utility>
+
+// Разбор выражения-литерала во время компиляции:
+//
+//     constexpr auto f = CALC_STATIC_EXPR("if(x > 0, x, -x) * k");
+//     double y = f(x, k); // переменные - в порядке первого появления
+//
+// Лексика, приоритеты и алгоритм сортировочной станции те же, что у
+// Lexer/Parser (таблица из grammar.h). Синтаксическая ошибка в литерале -
+// ошибка компиляции. RPN превращается в дерево шаблонов Node<Source, I>, которое
+// компилятор встраивает целиком, как написанное вручную выражение.
+// Деление на ноль - как в Evaluator: MathError, только если частное дошло до
+// результата (if(x == 0, 0, y / x) безопасно). В выражениях без деления
+// проверка исчезает при компиляции.
+
+namespace static_expression {
+
+enum class Op {
+    Number, Variable,
+    Add, Sub, Mul, Div, Pow,
+    Less, LessEqual, Greater, GreaterEqual, Equal, NotEqual, And, Or,
+    Negate, Not, Sin, Cos, Factorial,
+    Select
+};
+
+struct Instruction {
+    Op op = Op::Number;
+    double value = 0;
+    size_t variable = 0;
+    size_t first = 0; // Первая инструкция поддерева
+};
+
+template <size_t N>
+struct Program {
+    Instruction code[N] = {};
+    size_t size = 0;
+    std::string_view variables[N] = {};
+    size_t variableCount = 0;
+};
+
+struct StaticToken {
+    TokenType type = TokenType::Number;
+    std::string_view lexeme;
+    double value = 0;
+};
+
+constexpr bool isDigit(char c) { return c >= '0' && c <= '9'; }
+constexpr bool isAlpha(char c) { return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z'); }
+constexpr bool isSpace(char c) { return c == ' ' || (c >= '\t' && c <= '\r'); }
+
+constexpr size_t arity(Op op) {
+    switch (op) {
+        case Op::Number: case Op::Variable: return 0;
+        case Op::Negate: case Op::Not: case Op::Sin: case Op::Cos: case Op::Factorial: return 1;
+        case Op::Select: return 3;
+        default: return 2;
+    }
+}
+
+constexpr Op opOf(std::string_view lexeme) {
+    constexpr struct { std::string_view lexeme; Op op; } table[] = {
+        {"+", Op::Add}, {"-", Op::Sub}, {"*", Op::Mul}, {"/", Op::Div}, {"^", Op::Pow},
+        {"<", Op::Less}, {"<=", Op::LessEqual}, {">", Op::Greater}, {">=", Op::GreaterEqual},
+        {"==", Op::Equal}, {"!=", Op::NotEqual}, {"&&", Op::And}, {"||", Op::Or},
+        {"unary_minus", Op::Negate}, {"not", Op::Not}, {"sin", Op::Sin}, {"cos", Op::Cos},
+        {"!", Op::Factorial}, {"if", Op::Select},
+    };
+    for (const auto& entry : table) {
+        if (entry.lexeme == lexeme) return entry.op;
+    }
+    throw RuntimeError("Unknown operator");
+}
+
+// Число как мантисса / 10^k: для литералов до 15 знаков результат
+// совпадает с std::stod
+constexpr double parseNumber(std::string_view text) {
+    double mantissa = 0;
+    double scale = 1;
+    bool fraction = false;
+    for (char c : text) {
+        if (c == '.') {
+            fraction = true;
+            continue;
+        }
+        mantissa = mantissa * 10 + (c - '0');
+        if (fraction) scale *= 10;
+    }
+    return mantissa / scale;
+}
+
+// Повторяет Lexer::tokenize, результат - число токенов
+template <size_t N>
+constexpr size_t tokenize(std::string_view input, StaticToken (&tokens)[N]) {
+    size_t count = 0;
+    size_t pos = 0;
+
+    while (pos < input.size()) {
+        char c = input[pos];
+        if (isSpace(c)) {
+            ++pos;
+            continue;
+        }
+
+        StaticToken& token = tokens[count];
+        size_t start = pos;
+
+        if (isDigit(c)) {
+            bool hasDecimal = false;
+            while (pos < input.size() &&
+                   (isDigit(input[pos]) || (input[pos] == '.' && !hasDecimal))) {
+                hasDecimal = hasDecimal || input[pos] == '.';
+                ++pos;
+            }
+            token.type = TokenType::Number;
+            token.value = parseNumber(input.substr(start, pos - start));
+        }
+        else if (isAlpha(c) || c == '_') {
+            while (pos < input.size() &&
+                   (isAlpha(input[pos]) || isDigit(input[pos]) || input[pos] == '_')) {
+                ++pos;
+            }
+            token.lexeme = input.substr(start, pos - start);
+            if (token.lexeme == "PI") {
+                token.type = TokenType::Constant;
+                token.value = M_PI;
+            } else if (isWindowFunction(token.lexeme)) {
+                // Состояние между строками есть только у Evaluator/BatchEvaluator
+                throw SyntaxError("Window functions are not supported in static expressions");
+            } else if (token.lexeme == "sin" || token.lexeme == "cos" ||
+                       token.lexeme == "if" || token.lexeme == "not") {
+                token.type = TokenType::Function;
+            } else {
+                token.type = TokenType::Variable;
+            }
+        }
+        else if (c == '-' && (count == 0 ||
+                 tokens[count - 1].type == TokenType::Operator ||
+                 tokens[count - 1].type == TokenType::LeftBracket ||
+                 tokens[count - 1].type == TokenType::Function ||
+                 tokens[count - 1].type == TokenType::Comma)) {
+            ++pos;
+            token.type = TokenType::Function;
+            token.lexeme = "unary_minus";
+        }
+        else if (c == '<' || c == '>' || c == '=' || c == '&' || c == '|' ||
+                 (c == '!' && pos + 1 < input.size() && input[pos + 1] == '=')) {
+            ++pos;
+            char next = pos < input.size() ? input[pos] : '\0';
+            if ((next == '=' && c != '&' && c != '|') ||
+                ((c == '&' || c == '|') && next == c)) {
+                ++pos;
+            } else if (c == '=' || c == '&' || c == '|') {
+                throw SyntaxError("Unexpected character");
+            }
+            token.type = TokenType::Operator;
+            token.lexeme = input.substr(start, pos - start);
+        }
+        else if (c == '!') {
+            ++pos;
+            token.type = TokenType::Function;
+            token.lexeme = "!";
+        }
+        else if (c == '+' || c == '-' || c == '*' || c == '/' || c == '^') {
+            ++pos;
+            token.type = TokenType::Operator;
+            token.lexeme = input.substr(start, 1);
+        }
+        else if (c == '(' || c == '[' || c == '{') {
+            ++pos;
+            token.type = TokenType::LeftBracket;
+            token.lexeme = input.substr(start, 1);
+        }
+        else if (c == ')' || c == ']' || c == '}') {
+            ++pos;
+            token.type = TokenType::RightBracket;
+            token.lexeme = input.substr(start, 1);
+        }
+        else if (c == ',') {
+            ++pos;
+            token.type = TokenType::Comma;
+        }
+        else {
+            throw SyntaxError("Unexpected character");
+        }
+        ++count;
+    }
+
+    return count;
+}
+
+// Выход сортировочной станции: сразу строит инструкции и следит за глубиной стека
+template <size_t N>
+struct Emitter {
+    Program<N> program;
+    size_t starts[N] = {};
+    size_t depth = 0;
+
+    constexpr void emit(const StaticToken& token) {
+        Instruction ins;
+        size_t index = program.size;
+
+        if (token.type == TokenType::Number || token.type == TokenType::Constant) {
+            ins.op = Op::Number;
+            ins.value = token.value;
+        } else if (token.type == TokenType::Variable) {
+            ins.op = Op::Variable;
+            ins.variable = program.variableCount;
+            for (size_t i = 0; i < program.variableCount; ++i) {
+                if (program.variables[i] == token.lexeme) ins.variable = i;
+            }
+            if (ins.variable == program.variableCount) {
+                program.variables[program.variableCount++] = token.lexeme;
+            }
+        } else {
+            ins.op = opOf(token.lexeme);
+        }
+
+        size_t k = arity(ins.op);
+        if (depth < k) {
+            throw RuntimeError("Not enough operands");
+        }
+        ins.first = (k == 0) ? index : starts[depth - k];
+        depth -= k;
+        starts[depth++] = ins.first;
+
+        program.code[program.size++] = ins;
+    }
+};
+
+// Повторяет Parser::parseToRPN
+template <size_t N>
+constexpr Program<N> compile(std::string_view input) {
+    StaticToken tokens[N] = {};
+    size_t count = tokenize(input, tokens);
+
+    Emitter<N> out;
+    StaticToken stack[N] = {};
+    size_t arguments[N] = {}; // Для скобки stack[i] - число аргументов в ней
+    size_t top = 0;
+
+    for (size_t i = 0; i < count; ++i) {
+        const StaticToken& token = tokens[i];
+
+        switch (token.type) {
+            case TokenType::Number:
+            case TokenType::Constant:
+            case TokenType::Variable:
+                out.emit(token);
+                break;
+
+            case TokenType::Function:
+                stack[top++] = token;
+                break;
+
+            case TokenType::LeftBracket:
+                arguments[top] = 1;
+                stack[top++] = token;
+                break;
+
+            case TokenType::Operator: {
+                int precedence = precedenceOf(token.lexeme);
+                bool leftAssociative = isLeftAssociativeOperator(token.lexeme);
+                while (top > 0) {
+                    const StaticToken& last = stack[top - 1];
+                    int lastPrecedence = precedenceOf(last.lexeme);
+                    if ((last.type == TokenType::Operator || last.type == TokenType::Function) &&
+                        (lastPrecedence > precedence ||
+                         (lastPrecedence == precedence && leftAssociative))) {
+                        out.emit(last);
+                        --top;
+                    } else {
+                        break;
+                    }
+                }
+                stack[top++] = token;
+                break;
+            }
+
+            case TokenType::RightBracket: {
+                char open = token.lexeme[0] == ')' ? '(' : token.lexeme[0] == ']' ? '[' : '{';
+                bool found = false;
+                while (top > 0) {
+                    const StaticToken& last = stack[--top];
+                    if (last.type == TokenType::LeftBracket && last.lexeme[0] == open) {
+                        found = true;
+                        break;
+                    }
+                    out.emit(last);
+                }
+                if (!found) {
+                    throw SyntaxError("Mismatched brackets");
+                }
+                if (top > 0 && stack[top - 1].type == TokenType::Function) {
+                    if (arguments[top] != functionArity(stack[top - 1].lexeme)) {
+                        throw SyntaxError("Wrong number of arguments");
+                    }
+                    out.emit(stack[--top]);
+                } else if (arguments[top] != 1) {
+                    throw SyntaxError("Comma outside of function arguments");
+                }
+                break;
+            }
+
+            case TokenType::Comma:
+                while (top > 0 && stack[top - 1].type != TokenType::LeftBracket) {
+                    out.emit(stack[--top]);
+                }
+                if (top == 0) {
+                    throw SyntaxError("Comma outside of function arguments");
+                }
+                ++arguments[top - 1];
+                break;
+        }
+    }
+
+    while (top > 0) {
+        const StaticToken& last = stack[--top];
+        if (last.type == TokenType::LeftBracket) {
+            throw SyntaxError("Mismatched brackets");
+        }
+        out.emit(last);
+    }
+
+    if (out.depth != 1) {
+        throw RuntimeError("Invalid expression: too many operands left");
+    }
+
+    return out.program;
+}
+
+template <typename Source>
+struct Compiled {
+    static constexpr size_t capacity = Source::text().size() + 1;
+    static constexpr Program<capacity> program = compile<capacity>(Source::text());
+};
+
+inline double factorial(double arg) {
+    if (arg < 0 || std::floor(arg) != arg) {
+        throw MathError("Factorial requires non-negative integer");
+    }
+    long fact = 1;
+    for (int i = 2; i <= static_cast<int>(arg); ++i) {
+        fact *= i;
+    }
+    return static_cast<double>(fact);
+}
+
+template <Op op>
+inline double binary(double l, double r, bool& divisionByZero) {
+    if constexpr (op == Op::Add) return l + r;
+    else if constexpr (op == Op::Sub) return l - r;
+    else if constexpr (op == Op::Mul) return l * r;
+    else if constexpr (op == Op::Div) {
+        divisionByZero = divisionByZero || r == 0;
+        return l / r;
+    }
+    else if constexpr (op == Op::Pow) return std::pow(l, r);
+    else if constexpr (op == Op::Less) return l < r;
+    else if constexpr (op == Op::LessEqual) return l <= r;
+    else if constexpr (op == Op::Greater) return l > r;
+    else if constexpr (op == Op::GreaterEqual) return l >= r;
+    else if constexpr (op == Op::Equal) return l == r;
+    else if constexpr (op == Op::NotEqual) return l != r;
+    else if constexpr (op == Op::And) return (l != 0) & (r != 0);
+    else return (l != 0) | (r != 0);
+}
+
+// Левая цепочка бинарных операций ((a + b) - c) * d: левый операнд каждой
+// операции - снова бинарная операция. Если строить для нее вложенные узлы,
+// глубина шаблонов растет с длиной выражения (a + b + ... упирается в
+// -ftemplate-depth), поэтому цепочка сворачивается в один узел.
+template <size_t L>
+struct LeftChain {
+    size_t operands[L + 1] = {}; // operands[0] - самый левый операнд
+    Op ops[L] = {};              // ops[k] применяется к результату и operands[k + 1]
+};
+
+template <size_t N>
+constexpr size_t leftChainLength(const Program<N>& program, size_t i) {
+    size_t length = 1;
+    for (size_t left = program.code[i - 1].first - 1; arity(program.code[left].op) == 2;
+         left = program.code[left - 1].first - 1) {
+        ++length;
+    }
+    return length;
+}
+
+template <size_t L, size_t N>
+constexpr LeftChain<L> leftChain(const Program<N>& program, size_t i) {
+    LeftChain<L> chain;
+    for (size_t k = L; k > 0; --k) {
+        chain.ops[k - 1] = program.code[i].op;
+        chain.operands[k] = i - 1;
+        i = program.code[i - 1].first - 1;
+    }
+    chain.operands[0] = i;
+    return chain;
+}
+
+// Узел дерева выражения: инструкция I программы и ее поддеревья
+template <typename Source, size_t I>
+struct Node {
+    static constexpr const auto& program = Compiled<Source>::program;
+    static constexpr Instruction ins = program.code[I];
+
+    static double eval(const double* vars, bool& divisionByZero) {
+        constexpr Op op = ins.op;
+
+        if constexpr (op == Op::Number) {
+            return ins.value;
+        }
+        else if constexpr (op == Op::Variable) {
+            return vars[ins.variable];
+        }
+        else if constexpr (arity(op) == 1) {
+            double a = Node<Source, I - 1>::eval(vars, divisionByZero);
+            if constexpr (op == Op::Negate) return -a;
+            else if constexpr (op == Op::Not) return a == 0;
+            else if constexpr (op == Op::Sin) return std::sin(a);
+            else if constexpr (op == Op::Cos) return std::cos(a);
+            else return factorial(a);
+        }
+        else if constexpr (arity(op) == 2) {
+            return evalChain(vars, divisionByZero,
+                             std::make_index_sequence<leftChainLength(program, I)>());
+        }
+        else {
+            constexpr size_t otherwise = I - 1;
+            constexpr size_t then = program.code[otherwise].first - 1;
+            constexpr size_t cond = program.code[then].first - 1;
+            // Деление на ноль в невыбранной ветви забывается
+            bool thenDivisionByZero = false;
+            bool otherwiseDivisionByZero = false;
+            double c = Node<Source, cond>::eval(vars, divisionByZero);
+            double a = Node<Source, then>::eval(vars, thenDivisionByZero);
+            double b = Node<Source, otherwise>::eval(vars, otherwiseDivisionByZero);
+            divisionByZero = divisionByZero ||
+                             (c != 0 ? thenDivisionByZero : otherwiseDivisionByZero);
+            return c != 0 ? a : b;
+        }
+    }
+
+    // Левая цепочка вычисляется одним узлом, операнды - слева направо, как в дереве
+    template <size_t... K>
+    static double evalChain(const double* vars, bool& divisionByZero, std::index_sequence<K...>) {
+        constexpr LeftChain<sizeof...(K)> chain = leftChain<sizeof...(K)>(program, I);
+        const double operands[] = {
+            Node<Source, chain.operands[0]>::eval(vars, divisionByZero),
+            Node<Source, chain.operands[K + 1]>::eval(vars, divisionByZero)...
+        };
+        double result = operands[0];
+        ((result = binary<chain.ops[K]>(result, operands[K + 1], divisionByZero)), ...);
+        return result;
+    }
+};
+
+} // namespace static_expression
+
+template <typename Source>
+class StaticExpression {
+    using Compiled = static_expression::Compiled<Source>;
+    // Разбор выполняется при создании типа, даже если выражение не вызывается
+    static_assert(Compiled::program.size > 0, "Empty expression");
+
+public:
+    static constexpr size_t arity = Compiled::program.variableCount;
+
+    static constexpr std::string_view variable(size_t index) {
+        return Compiled::program.variables[index];
+    }
+
+    template <typename... Args>
+    double operator()(Args... args) const {
+        static_assert(sizeof...(Args) == arity, "Wrong number of variables for expression");
+        const double vars[arity + 1] = {static_cast<double>(args)...};
+        bool divisionByZero = false;
+        double result = static_expression::Node<Source, Compiled::program.size - 1>::eval(
+            vars, divisionByZero);
+        if (divisionByZero) {
+            throw MathError("Division by zero");
+        }
+        return result;
+    }
+};
+
+// Цепочки a + b - c * ... любой длины разворачиваются в один узел, но вложенность
+// справа (a ^ b ^ c ..., a - (b - (c ...)), if в ветви else) стоит нескольких уровней
+// шаблонов на уровень: при -ftemplate-depth=900 (GCC по умолчанию) - около 350 уровней
+#define CALC_STATIC_EXPR(literal)                                                   \
+    ([] {                                                                           \
+        struct Source {                                                             \
+            static constexpr std::string_view text() { return literal; }           \
+        };                                                                          \
+        return StaticExpression<Source>{};                                          \
+    }())
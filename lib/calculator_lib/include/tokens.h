@@ -4,8 +4,8 @@
 
 enum class TokenType {
     Number,       // Число
-    Operator,     // +, -, *, /, ^
-    Function,     // sin, cos, ! (унарные)
+    Operator,     // +, -, *, /, ^, <, <=, >, >=, ==, !=, &&, ||
+    Function,     // sin, cos, not, ! (унарные), if (три аргумента), оконные (два)
     Constant,     // PI
     Variable,     // x, y, z
     LeftBracket,  // ( [ {
@@ -26,4 +26,9 @@ struct Token {
     
     Token(double value)
         : type(TokenType::Number), lexeme(""), value(value) {}
+
+    bool operator==(const Token& other) const {
+        return type == other.type && lexeme == other.lexeme && value == other.value;
+    }
+    bool operator!=(const Token& other) const { return !(*this == other); }
 };
\ No newline at end of file
@@ -0,0 +1,69 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <cstddef>
+
+// Состояние оконной функции для упорядоченных строк. push() принимает
+// очередное значение и возвращает результат для этой строки за O(1)
+// амортизированно:
+//   rolling_mean(x, n) - скользящая сумма по кольцевому буферу
+//   rolling_min/rolling_max(x, n) - монотонная очередь
+//   lag(x, k) - значение k строк назад (NaN, пока строк меньше k)
+//   ema(x, alpha) - экспоненциальное сглаживание
+// Пока строк меньше n, окно неполное: агрегат берется по имеющимся строкам.
+// Окно длиннее kMaxSize строк - MathError.
+//
+// Флаг деления на ноль (см. Evaluator) остается при значении, пока оно в окне:
+// результат помечен, если в окне есть помеченное значение (для lag - если
+// помечено возвращаемое значение, для ema - если такое значение уже было).
+class WindowState {
+public:
+    static constexpr size_t kMaxSize = size_t(1) << 24;
+
+    WindowState(const std::string& function, double parameter);
+
+    double push(double value) {
+        bool divisionByZero = false;
+        return push(value, divisionByZero);
+    }
+    // divisionByZero: на входе - флаг value, на выходе - флаг результата
+    double push(double value, bool& divisionByZero);
+
+    double parameter() const { return parameter_; }
+
+private:
+    enum class Kind { Mean, Min, Max, Lag, Ema };
+
+    double pushMean(double value);
+    double pushExtremum(double value);
+    double pushLag(double value);
+    bool pushFlag(bool divisionByZero);
+
+    double parameter_;
+    Kind kind_;
+    size_t size_ = 0;
+    double alpha_ = 0;
+    size_t count_ = 0; // Сколько строк уже прошло
+
+    // Кольцевой буфер последних size_ значений (mean, lag). Сумма - только по
+    // конечным значениям, inf и NaN считаются отдельно: иначе после выхода
+    // inf из окна sum_ - inf давало бы NaN до ближайшего пересчета
+    std::vector<double> ring_;
+    double sum_ = 0;
+    size_t nanCount_ = 0;
+    size_t positiveInfCount_ = 0;
+    size_t negativeInfCount_ = 0;
+
+    // Флаги деления на ноль по строкам окна, заводятся при первом таком значении
+    std::vector<unsigned char> flags_;
+    size_t flaggedCount_ = 0;
+
+    // Монотонная очередь (min, max) на кольцевом буфере: индексы строк и значения
+    std::vector<size_t> dequeIndex_;
+    std::vector<double> dequeValue_;
+    size_t head_ = 0;
+    size_t tail_ = 0;
+
+    double ema_ = 0;
+    bool emaDivisionByZero_ = false;
+};
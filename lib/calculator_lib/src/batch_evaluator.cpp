@@ -0,0 +1,327 @@
+#include "../include/batch_evaluator.h"
+#include "../include/error.h"
+#include "../include/grammar.h"
+#include <algorithm>
+#include <cmath>
+#include <exception>
+#include <thread>
+
+void BatchEvaluator::setVariable(const std::string& name, double value) {
+    variables_[name] = value;
+}
+
+void BatchEvaluator::setColumn(const std::string& name, const double* data) {
+    columns_[name] = data;
+}
+
+void BatchEvaluator::resetState() {
+    windows_.clear();
+}
+
+BatchEvaluator::Program BatchEvaluator::compile(const std::vector<Token>& rpnTokens) {
+    static const std::map<std::string, Op> operators = {
+        {"+", Op::Add}, {"-", Op::Sub}, {"*", Op::Mul}, {"/", Op::Div}, {"^", Op::Pow},
+        {"<", Op::Less}, {"<=", Op::LessEqual}, {">", Op::Greater}, {">=", Op::GreaterEqual},
+        {"==", Op::Equal}, {"!=", Op::NotEqual}, {"&&", Op::And}, {"||", Op::Or},
+    };
+    static const std::map<std::string, Op> functions = {
+        {"unary_minus", Op::Negate}, {"not", Op::Not},
+        {"sin", Op::Sin}, {"cos", Op::Cos}, {"!", Op::Factorial},
+        {"if", Op::Select},
+    };
+
+    // Состояние окон принадлежит одному выражению: другое начинает ряд заново
+    if (!windows_.empty() && rpnTokens != windowsProgram_) {
+        windows_.clear();
+    }
+    if (windows_.empty()) {
+        bool stateful = std::any_of(rpnTokens.begin(), rpnTokens.end(), [](const Token& token) {
+            return token.type == TokenType::Function && isWindowFunction(token.lexeme);
+        });
+        if (stateful) windowsProgram_ = rpnTokens;
+    }
+
+    Program program;
+    size_t depth = 0;
+
+    for (size_t index = 0; index < rpnTokens.size(); ++index) {
+        const Token& token = rpnTokens[index];
+        Instruction instruction{Op::Constant};
+        size_t arity = 0;
+
+        switch (token.type) {
+            case TokenType::Number:
+                instruction.value = token.value;
+                break;
+
+            case TokenType::Constant:
+                if (token.lexeme == "PI") {
+                    instruction.value = M_PI;
+                } else {
+                    throw RuntimeError("Unknown constant: " + token.lexeme);
+                }
+                break;
+
+            case TokenType::Variable: {
+                // Столбцы важнее скаляров с тем же именем
+                auto column = columns_.find(token.lexeme);
+                auto variable = variables_.find(token.lexeme);
+                if (column != columns_.end()) {
+                    instruction.op = Op::Column;
+                    instruction.column = column->second;
+                } else if (variable != variables_.end()) {
+                    instruction.value = variable->second;
+                } else {
+                    throw RuntimeError("Undefined variable: " + token.lexeme);
+                }
+                break;
+            }
+
+            case TokenType::Operator: {
+                auto it = operators.find(token.lexeme);
+                if (it == operators.end()) {
+                    throw RuntimeError("Unknown operator: " + token.lexeme);
+                }
+                instruction.op = it->second;
+                program.divides = program.divides || it->second == Op::Div;
+                arity = 2;
+                break;
+            }
+
+            case TokenType::Function: {
+                if (isWindowFunction(token.lexeme)) {
+                    // Параметр окна общий для всех строк: число или скалярная переменная
+                    if (program.code.empty() || program.code.back().op != Op::Constant) {
+                        throw RuntimeError("Window parameter must be a constant: " + token.lexeme);
+                    }
+                    double parameter = program.code.back().value;
+                    auto it = windows_.find(index);
+                    if (it == windows_.end()) {
+                        it = windows_.emplace(index, WindowState(token.lexeme, parameter)).first;
+                    } else if (it->second.parameter() != parameter) {
+                        throw RuntimeError("Window parameter changed within a series: " + token.lexeme);
+                    }
+                    instruction.op = Op::Window;
+                    instruction.window = &it->second;
+                    program.stateful = true;
+                    arity = 2;
+                    break;
+                }
+                
+                auto it = functions.find(token.lexeme);
+                if (it == functions.end()) {
+                    throw RuntimeError("Unknown function: " + token.lexeme);
+                }
+                instruction.op = it->second;
+                arity = (it->second == Op::Select) ? 3 : 1;
+                break;
+            }
+
+            default:
+                throw RuntimeError("Unexpected token in RPN");
+        }
+
+        if (depth < arity) {
+            throw RuntimeError("Not enough operands for " + token.lexeme);
+        }
+        depth = (arity == 0) ? depth + 1 : depth - arity + 1;
+        program.depth = std::max(program.depth, depth);
+        program.code.push_back(instruction);
+    }
+
+    if (depth != 1) {
+        throw RuntimeError("Invalid expression: too many operands left");
+    }
+
+    return program;
+}
+
+void BatchEvaluator::evaluateBlock(const Program& program, size_t begin, size_t n,
+                                   std::vector<double>& stack,
+                                   std::vector<unsigned char>& divisionByZero) {
+    // Слот i стека - это массив из kBlockSize значений, рядом - флаги деления на ноль
+    auto slot = [&](size_t i) { return stack.data() + i * kBlockSize; };
+    auto flags = [&](size_t i) { return divisionByZero.data() + i * kBlockSize; };
+    const bool tracked = program.divides;
+    size_t sp = 0;
+
+    for (const auto& ins : program.code) {
+        switch (ins.op) {
+            case Op::Constant: {
+                if (tracked) std::fill(flags(sp), flags(sp) + n, 0);
+                double* r = slot(sp++);
+                std::fill(r, r + n, ins.value);
+                break;
+            }
+            case Op::Column: {
+                if (tracked) std::fill(flags(sp), flags(sp) + n, 0);
+                double* r = slot(sp++);
+                std::copy(ins.column + begin, ins.column + begin + n, r);
+                break;
+            }
+            case Op::Select: {
+                double* c = slot(sp - 3);
+                const double* a = slot(sp - 2);
+                const double* b = slot(sp - 1);
+                if (tracked) {
+                    // Флаг невыбранной ветви отбрасывается вместе с ее значением
+                    unsigned char* fc = flags(sp - 3);
+                    const unsigned char* fa = flags(sp - 2);
+                    const unsigned char* fb = flags(sp - 1);
+                    for (size_t i = 0; i < n; ++i) fc[i] |= c[i] != 0 ? fa[i] : fb[i];
+                }
+                // Смешивание вместо перехода: блок остается векторизованным
+                for (size_t i = 0; i < n; ++i) c[i] = c[i] != 0 ? a[i] : b[i];
+                sp -= 2;
+                break;
+            }
+            case Op::Negate: case Op::Not: case Op::Sin: case Op::Cos: case Op::Factorial: {
+                double* r = slot(sp - 1);
+                switch (ins.op) {
+                    case Op::Negate: for (size_t i = 0; i < n; ++i) r[i] = -r[i]; break;
+                    case Op::Not:    for (size_t i = 0; i < n; ++i) r[i] = (r[i] == 0); break;
+                    case Op::Sin:    for (size_t i = 0; i < n; ++i) r[i] = std::sin(r[i]); break;
+                    case Op::Cos:    for (size_t i = 0; i < n; ++i) r[i] = std::cos(r[i]); break;
+                    default:
+                        for (size_t i = 0; i < n; ++i) {
+                            double arg = r[i];
+                            if (arg < 0 || std::floor(arg) != arg) {
+                                throw MathError("Factorial requires non-negative integer");
+                            }
+                            long fact = 1;
+                            for (int k = 2; k <= static_cast<int>(arg); ++k) {
+                                fact *= k;
+                            }
+                            r[i] = static_cast<double>(fact);
+                        }
+                        break;
+                }
+                break;
+            }
+            default: {
+                double* l = slot(sp - 2);
+                const double* r = slot(sp - 1);
+                if (tracked) {
+                    unsigned char* fl = flags(sp - 2);
+                    const unsigned char* fr = flags(sp - 1);
+                    for (size_t i = 0; i < n; ++i) fl[i] |= fr[i];
+                    if (ins.op == Op::Div) {
+                        for (size_t i = 0; i < n; ++i) fl[i] |= (r[i] == 0);
+                    }
+                }
+                switch (ins.op) {
+                    case Op::Add: for (size_t i = 0; i < n; ++i) l[i] = l[i] + r[i]; break;
+                    case Op::Sub: for (size_t i = 0; i < n; ++i) l[i] = l[i] - r[i]; break;
+                    case Op::Mul: for (size_t i = 0; i < n; ++i) l[i] = l[i] * r[i]; break;
+                    case Op::Div: for (size_t i = 0; i < n; ++i) l[i] = l[i] / r[i]; break;
+                    case Op::Pow: for (size_t i = 0; i < n; ++i) l[i] = std::pow(l[i], r[i]); break;
+                    case Op::Less:         for (size_t i = 0; i < n; ++i) l[i] = (l[i] < r[i]); break;
+                    case Op::LessEqual:    for (size_t i = 0; i < n; ++i) l[i] = (l[i] <= r[i]); break;
+                    case Op::Greater:      for (size_t i = 0; i < n; ++i) l[i] = (l[i] > r[i]); break;
+                    case Op::GreaterEqual: for (size_t i = 0; i < n; ++i) l[i] = (l[i] >= r[i]); break;
+                    case Op::Equal:        for (size_t i = 0; i < n; ++i) l[i] = (l[i] == r[i]); break;
+                    case Op::NotEqual:     for (size_t i = 0; i < n; ++i) l[i] = (l[i] != r[i]); break;
+                    case Op::And: for (size_t i = 0; i < n; ++i) l[i] = (l[i] != 0) & (r[i] != 0); break;
+                    case Op::Or:  for (size_t i = 0; i < n; ++i) l[i] = (l[i] != 0) | (r[i] != 0); break;
+                    case Op::Window:
+                        // Строки блока идут по порядку, состояние переходит в следующий блок
+                        if (tracked) {
+                            unsigned char* fl = flags(sp - 2);
+                            for (size_t i = 0; i < n; ++i) {
+                                bool divisionByZero = fl[i];
+                                l[i] = ins.window->push(l[i], divisionByZero);
+                                fl[i] = divisionByZero;
+                            }
+                        } else {
+                            for (size_t i = 0; i < n; ++i) l[i] = ins.window->push(l[i]);
+                        }
+                        break;
+                    default:
+                        throw RuntimeError("Unknown instruction");
+                }
+                --sp;
+                break;
+            }
+        }
+    }
+
+    if (tracked) {
+        const unsigned char* result = flags(0);
+        bool zero = false;
+        for (size_t i = 0; i < n; ++i) zero |= (result[i] != 0);
+        if (zero) throw MathError("Division by zero");
+    }
+}
+
+template <typename Consume>
+void BatchEvaluator::run(const Program& program, size_t rows, unsigned threads,
+                         Consume&& consume) {
+    size_t blocks = (rows + kBlockSize - 1) / kBlockSize;
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    if (program.stateful) {
+        threads = 1;
+    }
+    threads = static_cast<unsigned>(std::min<size_t>(threads, std::max<size_t>(blocks, 1)));
+
+    // Каждый поток получает непрерывный диапазон блоков и свой стек
+    auto worker = [&](unsigned index, std::exception_ptr& error) {
+        try {
+            std::vector<double> stack(program.depth * kBlockSize);
+            std::vector<unsigned char> divisionByZero(program.divides ? program.depth * kBlockSize : 0);
+            size_t first = blocks * index / threads;
+            size_t last = blocks * (index + 1) / threads;
+            for (size_t block = first; block < last; ++block) {
+                size_t begin = block * kBlockSize;
+                size_t n = std::min(kBlockSize, rows - begin);
+                evaluateBlock(program, begin, n, stack, divisionByZero);
+                consume(index, begin, n, static_cast<const double*>(stack.data()));
+            }
+        } catch (...) {
+            error = std::current_exception();
+        }
+    };
+
+    std::vector<std::exception_ptr> errors(threads);
+    std::vector<std::thread> pool;
+    for (unsigned i = 1; i < threads; ++i) {
+        pool.emplace_back(worker, i, std::ref(errors[i]));
+    }
+    worker(0, errors[0]);
+    for (auto& thread : pool) {
+        thread.join();
+    }
+
+    for (const auto& error : errors) {
+        if (error) std::rethrow_exception(error);
+    }
+}
+
+void BatchEvaluator::evaluateRPN(const std::vector<Token>& rpnTokens, size_t rows,
+                                 double* out, unsigned threads) {
+    Program program = compile(rpnTokens);
+    run(program, rows, threads,
+        [out](unsigned, size_t begin, size_t n, const double* values) {
+            std::copy(values, values + n, out + begin);
+        });
+}
+
+void BatchEvaluator::reduceRPN(const std::vector<Token>& rpnTokens, size_t rows,
+                               Accumulator& accumulator, unsigned threads) {
+    Program program = compile(rpnTokens);
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    // Пустые аккумуляторы потоков с той же спецификацией, сливаются по порядку
+    std::vector<Accumulator> partial(threads, Accumulator(accumulator.spec()));
+    run(program, rows, threads,
+        [&partial](unsigned index, size_t, size_t n, const double* values) {
+            partial[index].add(values, n);
+        });
+
+    for (const auto& part : partial) {
+        accumulator.merge(part);
+    }
+}
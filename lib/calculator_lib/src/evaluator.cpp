@@ -1,5 +1,7 @@
 #include "../include/evaluator.h"
 #include "../include/error.h"
+#include "../include/grammar.h"
+#include <algorithm>
 #include <cmath>
 #include <iostream>
 
@@ -7,37 +9,59 @@ void Evaluator::setVariable(const std::string& name, double value) {
     variables_[name] = value;
 }
 
+void Evaluator::resetState() {
+    windows_.clear();
+}
+
 void Evaluator::processOperator(const Token& token) {
     if (operandStack_.size() < 2) {
         throw RuntimeError("Not enough operands for operator " + token.lexeme);
     }
     
-    double right = operandStack_.top(); operandStack_.pop();
-    double left = operandStack_.top(); operandStack_.pop();
+    Operand rightOperand = operandStack_.top(); operandStack_.pop();
+    Operand leftOperand = operandStack_.top(); operandStack_.pop();
+    double right = rightOperand.value;
+    double left = leftOperand.value;
     double result = 0;
+    bool divisionByZero = leftOperand.divisionByZero || rightOperand.divisionByZero;
     
-    switch (token.lexeme[0]) {
+    const std::string& op = token.lexeme;
+    
+    // Сравнения и логические операции дают 1 или 0
+    switch (op[0]) {
         case '+': result = left + right; break;
         case '-': result = left - right; break;
         case '*': result = left * right; break;
         case '/': 
-            if (right == 0) throw MathError("Division by zero");
+            divisionByZero = divisionByZero || right == 0;
             result = left / right;
             break;
         case '^': result = std::pow(left, right); break;
+        case '<': result = (op.size() == 1) ? (left < right) : (left <= right); break;
+        case '>': result = (op.size() == 1) ? (left > right) : (left >= right); break;
+        case '=': result = (left == right); break;
+        case '!': result = (left != right); break;
+        case '&': result = (left != 0) & (right != 0); break;
+        case '|': result = (left != 0) | (right != 0); break;
         default:
             throw RuntimeError("Unknown operator: " + token.lexeme);
     }
     
-    operandStack_.push(result);
+    operandStack_.push({result, divisionByZero});
 }
 
 void Evaluator::processFunction(const Token& token) {
+    if (token.lexeme == "if") {
+        processConditional(token);
+        return;
+    }
+    
     if (operandStack_.empty()) {
         throw RuntimeError("Not enough operands for function " + token.lexeme);
     }
     
-    double arg = operandStack_.top(); operandStack_.pop();
+    Operand operand = operandStack_.top(); operandStack_.pop();
+    double arg = operand.value;
     double result = 0;
     
     if (token.lexeme == "sin") {
@@ -60,26 +84,77 @@ void Evaluator::processFunction(const Token& token) {
     else if (token.lexeme == "unary_minus") {
         result = -arg;
     }
+    else if (token.lexeme == "not") {
+        result = (arg == 0);
+    }
     else {
         throw RuntimeError("Unknown function: " + token.lexeme);
     }
     
-    operandStack_.push(result);
+    operandStack_.push({result, operand.divisionByZero});
+}
+
+void Evaluator::processConditional(const Token& token) {
+    if (operandStack_.size() < 3) {
+        throw RuntimeError("Not enough operands for function " + token.lexeme);
+    }
+    
+    Operand otherwise = operandStack_.top(); operandStack_.pop();
+    Operand then = operandStack_.top(); operandStack_.pop();
+    Operand cond = operandStack_.top(); operandStack_.pop();
+    
+    // Обе ветви уже вычислены (RPN), поэтому if(c, a, b) - это выбор без перехода.
+    // Деление на ноль в невыбранной ветви забывается
+    Operand selected = cond.value != 0 ? then : otherwise;
+    selected.divisionByZero = selected.divisionByZero || cond.divisionByZero;
+    operandStack_.push(selected);
+}
+
+void Evaluator::processWindow(const Token& token, size_t site) {
+    if (operandStack_.size() < 2) {
+        throw RuntimeError("Not enough operands for function " + token.lexeme);
+    }
+    
+    double parameter = operandStack_.top().value; operandStack_.pop();
+    Operand value = operandStack_.top(); operandStack_.pop();
+    
+    auto it = windows_.find(site);
+    if (it == windows_.end()) {
+        it = windows_.emplace(site, WindowState(token.lexeme, parameter)).first;
+    } else if (it->second.parameter() != parameter) {
+        throw RuntimeError("Window parameter changed within a series: " + token.lexeme);
+    }
+    
+    // Помеченное делением на ноль значение остается помеченным, пока оно в окне
+    double result = it->second.push(value.value, value.divisionByZero);
+    operandStack_.push({result, value.divisionByZero});
 }
 
 double Evaluator::evaluateRPN(const std::vector<Token>& rpnTokens) {
     // Очищаем стек перед вычислением
     while (!operandStack_.empty()) operandStack_.pop();
     
-    for (const auto& token : rpnTokens) {
+    // Состояние окон принадлежит одному выражению: другое начинает ряд заново
+    if (!windows_.empty() && rpnTokens != windowsProgram_) {
+        windows_.clear();
+    }
+    if (windows_.empty()) {
+        bool stateful = std::any_of(rpnTokens.begin(), rpnTokens.end(), [](const Token& token) {
+            return token.type == TokenType::Function && isWindowFunction(token.lexeme);
+        });
+        if (stateful) windowsProgram_ = rpnTokens;
+    }
+    
+    for (size_t i = 0; i < rpnTokens.size(); ++i) {
+        const Token& token = rpnTokens[i];
         switch (token.type) {
             case TokenType::Number:
-                operandStack_.push(token.value);
+                operandStack_.push({token.value});
                 break;
                 
             case TokenType::Constant:
                 if (token.lexeme == "PI") {
-                    operandStack_.push(M_PI);
+                    operandStack_.push({M_PI});
                 } else {
                     throw RuntimeError("Unknown constant: " + token.lexeme);
                 }
@@ -87,7 +162,7 @@ double Evaluator::evaluateRPN(const std::vector<Token>& rpnTokens) {
                 
             case TokenType::Variable:
                 if (variables_.find(token.lexeme) != variables_.end()) {
-                    operandStack_.push(variables_[token.lexeme]);
+                    operandStack_.push({variables_[token.lexeme]});
                 } else {
                     throw RuntimeError("Undefined variable: " + token.lexeme);
                 }
@@ -98,7 +173,17 @@ double Evaluator::evaluateRPN(const std::vector<Token>& rpnTokens) {
                 break;
                 
             case TokenType::Function:
-                processFunction(token);
+                if (isWindowFunction(token.lexeme)) {
+                    // Параметр окна - число или переменная, как в BatchEvaluator
+                    if (i == 0 || (rpnTokens[i - 1].type != TokenType::Number &&
+                                   rpnTokens[i - 1].type != TokenType::Constant &&
+                                   rpnTokens[i - 1].type != TokenType::Variable)) {
+                        throw RuntimeError("Window parameter must be a constant: " + token.lexeme);
+                    }
+                    processWindow(token, i);
+                } else {
+                    processFunction(token);
+                }
                 break;
                 
             default:
@@ -110,5 +195,9 @@ double Evaluator::evaluateRPN(const std::vector<Token>& rpnTokens) {
         throw RuntimeError("Invalid expression: too many operands left");
     }
     
-    return operandStack_.top();
+    if (operandStack_.top().divisionByZero) {
+        throw MathError("Division by zero");
+    }
+    
+    return operandStack_.top().value;
 }
\ No newline at end of file
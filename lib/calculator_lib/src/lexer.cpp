@@ -1,124 +1,194 @@
 #include "../include/lexer.h"
 #include "../include/error.h"
+#include "../include/grammar.h"
 #include <cctype>
 #include <cmath>
 #include <map>
 
+void Lexer::reset(std::istream& input) {
+    stream_ = &input;
+    chunk_.resize(kChunkSize);
+    input_ = std::string_view();
+    pos_ = 0;
+    hasLast_ = false;
+}
+
+void Lexer::reset(std::string_view input) {
+    stream_ = nullptr;
+    input_ = input;
+    pos_ = 0;
+    hasLast_ = false;
+}
+
+bool Lexer::fill() {
+    if (!stream_) return false;
+
+    stream_->read(&chunk_[0], static_cast<std::streamsize>(chunk_.size()));
+    size_t count = static_cast<size_t>(stream_->gcount());
+    input_ = std::string_view(chunk_.data(), count);
+    pos_ = 0;
+    return count > 0;
+}
+
+int Lexer::peek() {
+    if (pos_ >= input_.size() && !fill()) {
+        return -1;
+    }
+    return static_cast<unsigned char>(input_[pos_]);
+}
+
+void Lexer::advance() {
+    ++pos_;
+}
+
+void Lexer::emit(Token&& token, Token& out) {
+    hasLast_ = true;
+    lastType_ = token.type;
+    out = std::move(token);
+}
+
 void Lexer::skipWhitespace() {
-    while (pos_ < input_->size() && std::isspace((*input_)[pos_])) {
-        ++pos_;
+    int c;
+    while ((c = peek()) != -1 && std::isspace(c)) {
+        advance();
     }
 }
 
-void Lexer::tokenizeNumber() {
-    size_t start = pos_;
+void Lexer::tokenizeNumber(Token& out) {
+    std::string numStr;
     bool hasDecimal = false;
-    
-    while (pos_ < input_->size()) {
-        char c = (*input_)[pos_];
+
+    int c;
+    while ((c = peek()) != -1) {
         if (std::isdigit(c)) {
-            ++pos_;
+            numStr += static_cast<char>(c);
+            advance();
         } else if (c == '.' && !hasDecimal) {
             hasDecimal = true;
-            ++pos_;
+            numStr += '.';
+            advance();
         } else {
             break;
         }
     }
-    
-    std::string numStr = input_->substr(start, pos_ - start);
+
     try {
         double value = std::stod(numStr);
-        tokens_.push_back(Token(value));
+        emit(Token(value), out);
     } catch (...) {
         throw SyntaxError("Invalid number: " + numStr);
     }
 }
 
-void Lexer::tokenizeIdentifier() {
-    size_t start = pos_;
-    while (pos_ < input_->size() && 
-          (std::isalnum((*input_)[pos_]) || (*input_)[pos_] == '_')) {
-        ++pos_;
+void Lexer::tokenizeIdentifier(Token& out) {
+    std::string lexeme;
+    int c;
+    while ((c = peek()) != -1 && (std::isalnum(c) || c == '_')) {
+        lexeme += static_cast<char>(c);
+        advance();
     }
-    
-    std::string lexeme = input_->substr(start, pos_ - start);
-    
+
     // Проверка констант
     if (lexeme == "PI") {
-        tokens_.push_back(Token(TokenType::Constant, lexeme));
-    } 
+        emit(Token(TokenType::Constant, lexeme), out);
+    }
     // Проверка функций
-    else if (lexeme == "sin" || lexeme == "cos") {
-        tokens_.push_back(Token(TokenType::Function, lexeme));
+    else if (lexeme == "sin" || lexeme == "cos" || lexeme == "if" || lexeme == "not" ||
+             isWindowFunction(lexeme)) {
+        emit(Token(TokenType::Function, lexeme), out);
     }
     // Переменные
     else {
-        tokens_.push_back(Token(TokenType::Variable, lexeme));
+        emit(Token(TokenType::Variable, lexeme), out);
     }
 }
 
-void Lexer::tokenizeOperator() {
-    char op = (*input_)[pos_++];
+void Lexer::tokenizeOperator(Token& out) {
+    char op = static_cast<char>(peek());
+    advance();
     // Обработка унарного минуса
-    if (op == '-' && (tokens_.empty() || 
-        tokens_.back().type == TokenType::Operator ||
-        tokens_.back().type == TokenType::LeftBracket ||
-        tokens_.back().type == TokenType::Function)) {
-        tokens_.push_back(Token(TokenType::Function, "unary_minus"));
+    if (op == '-' && (!hasLast_ ||
+        lastType_ == TokenType::Operator ||
+        lastType_ == TokenType::LeftBracket ||
+        lastType_ == TokenType::Function ||
+        lastType_ == TokenType::Comma)) {
+        emit(Token(TokenType::Function, "unary_minus"), out);
+    }
+    // Операторы сравнения и логические: <, <=, >, >=, ==, !=, &&, ||
+    else if (op == '<' || op == '>' || op == '=' || op == '&' || op == '|' ||
+             (op == '!' && peek() == '=')) {
+        std::string lexeme(1, op);
+        int next = peek();
+        if (next == '=' && op != '&' && op != '|') {
+            lexeme += '=';
+            advance();
+        } else if ((op == '&' || op == '|') && next == op) {
+            lexeme += op;
+            advance();
+        } else if (op == '=' || op == '&' || op == '|') {
+            throw SyntaxError("Unexpected character: " + lexeme);
+        }
+        emit(Token(TokenType::Operator, lexeme), out);
     }
     // Обработка факториала
     else if (op == '!') {
-        tokens_.push_back(Token(TokenType::Function, "!"));
+        emit(Token(TokenType::Function, "!"), out);
     }
     // Бинарные операторы
     else {
-        tokens_.push_back(Token(TokenType::Operator, op));
+        emit(Token(TokenType::Operator, op), out);
     }
 }
 
-void Lexer::tokenizeBracket() {
-    char c = (*input_)[pos_];
-    
+void Lexer::tokenizeBracket(Token& out) {
+    char c = static_cast<char>(peek());
+
     if (c == '(' || c == '[' || c == '{') {
-        tokens_.push_back(Token(TokenType::LeftBracket, c));
+        emit(Token(TokenType::LeftBracket, c), out);
     } else if (c == ')' || c == ']' || c == '}') {
-        tokens_.push_back(Token(TokenType::RightBracket, c));
+        emit(Token(TokenType::RightBracket, c), out);
     }
-    ++pos_;
+    advance();
+}
+
+bool Lexer::next(Token& token) {
+    skipWhitespace();
+    int c = peek();
+    if (c == -1) return false;
+
+    if (std::isdigit(c)) {
+        tokenizeNumber(token);
+    }
+    else if (std::isalpha(c) || c == '_') {
+        tokenizeIdentifier(token);
+    }
+    else if (c == '+' || c == '-' || c == '*' || c == '/' || c == '^' || c == '!' ||
+             c == '<' || c == '>' || c == '=' || c == '&' || c == '|') {
+        tokenizeOperator(token);
+    }
+    else if (c == '(' || c == '[' || c == '{' ||
+             c == ')' || c == ']' || c == '}') {
+        tokenizeBracket(token);
+    }
+    else if (c == ',') {
+        emit(Token(TokenType::Comma, ','), token);
+        advance();
+    }
+    else {
+        throw SyntaxError("Unexpected character: " + std::string(1, static_cast<char>(c)));
+    }
+
+    return true;
 }
 
 std::vector<Token> Lexer::tokenize(const std::string& input) {
-    input_ = &input;
-    pos_ = 0;
-    tokens_.clear();
-    
-    while (pos_ < input.size()) {
-        skipWhitespace();
-        if (pos_ >= input.size()) break;
-        
-        char c = input[pos_];
-        if (std::isdigit(c)) {
-            tokenizeNumber();
-        }
-        else if (std::isalpha(c) || c == '_') {
-            tokenizeIdentifier();
-        }
-        else if (c == '+' || c == '-' || c == '*' || c == '/' || c == '^' || c == '!') {
-            tokenizeOperator();
-        }
-        else if (c == '(' || c == '[' || c == '{' || 
-                 c == ')' || c == ']' || c == '}') {
-            tokenizeBracket();
-        }
-        else if (c == ',') {
-            tokens_.push_back(Token(TokenType::Comma, c));
-            ++pos_;
-        }
-        else {
-            throw SyntaxError("Unexpected character: " + std::string(1, c));
-        }
+    reset(std::string_view(input));
+
+    std::vector<Token> tokens;
+    Token token(0.0);
+    while (next(token)) {
+        tokens.push_back(std::move(token));
     }
-    
-    return tokens_;
-}
\ No newline at end of file
+
+    return tokens;
+}
@@ -1,129 +1,180 @@
 #include "../include/parser.h"
 #include "../include/error.h"
+#include "../include/grammar.h"
 #include <map>
 #include <cctype>
 
 int Parser::getPrecedence(const Token& token) {
-    static const std::map<std::string, int> precedence = {
-        {"unary_minus", 6},
-        {"!", 5}, {"sin", 5}, {"cos", 5},
-        {"^", 4},
-        {"*", 3}, {"/", 3},
-        {"+", 2}, {"-", 2},
-    };
+    int level = precedenceOf(token.lexeme);
     
-    if (token.type == TokenType::Function) {
-        return precedence.at(token.lexeme);
+    if (token.type == TokenType::Function && level == 0) {
+        throw SyntaxError("Unknown function: " + token.lexeme);
     }
     
-    auto it = precedence.find(token.lexeme);
-    return (it != precedence.end()) ? it->second : 0;
+    return level;
 }
 
 bool Parser::isLeftAssociative(const Token& token) {
-    return (token.lexeme != "^" && token.lexeme != "!");
+    return isLeftAssociativeOperator(token.lexeme);
 }
 
-void Parser::handleOperator(const Token& token) {
+void Parser::handleOperator(Token&& token) {
+    int precedence = getPrecedence(token);
+    bool leftAssociative = isLeftAssociative(token);
+
     while (!stack_.empty()) {
-        Token top = stack_.top();
+        const Token& top = stack_.top();
         
         if ((top.type == TokenType::Operator || top.type == TokenType::Function) &&
-            (getPrecedence(top) > getPrecedence(token) || 
-             (getPrecedence(top) == getPrecedence(token) && isLeftAssociative(token)))) {
-            output_.push_back(top);
+            (getPrecedence(top) > precedence || 
+             (getPrecedence(top) == precedence && leftAssociative))) {
+            output_.push_back(std::move(stack_.top()));
             stack_.pop();
         } else {
             break;
         }
     }
-    stack_.push(token);
+    stack_.push(std::move(token));
 }
 
-void Parser::handleFunction(const Token& token) {
-    stack_.push(token);
+void Parser::handleFunction(Token&& token) {
+    stack_.push(std::move(token));
 }
 
-void Parser::handleLeftBracket(const Token& token) {
-    stack_.push(token);
+void Parser::handleLeftBracket(Token&& token) {
+    stack_.push(std::move(token));
+    arguments_.push(1);
 }
 
 void Parser::handleRightBracket(const Token& token) {
-    std::map<char, char> matching = {
+    static const std::map<char, char> matching = {
         {')', '('}, {']', '['}, {'}', '{'}
     };
     char openBracket = matching.at(token.lexeme[0]);
     
     bool found = false;
     while (!stack_.empty()) {
-        Token top = stack_.top();
-        stack_.pop();
+        Token& top = stack_.top();
         
         if (top.type == TokenType::LeftBracket && top.lexeme[0] == openBracket) {
+            stack_.pop();
             found = true;
             break;
         }
-        output_.push_back(top);
+        output_.push_back(std::move(top));
+        stack_.pop();
     }
     
     if (!found) {
         throw SyntaxError("Mismatched brackets");
     }
     
+    size_t arguments = arguments_.top();
+    arguments_.pop();
+    
+    // Аргументы считаются у каждого вызова: по одной лишь глубине стека
+    // лишний аргумент одного вызова компенсировал бы недостающий в другом
     if (!stack_.empty() && stack_.top().type == TokenType::Function) {
-        output_.push_back(stack_.top());
+        if (arguments != functionArity(stack_.top().lexeme)) {
+            throw SyntaxError("Wrong number of arguments for " + stack_.top().lexeme);
+        }
+        output_.push_back(std::move(stack_.top()));
         stack_.pop();
+    } else if (arguments != 1) {
+        throw SyntaxError("Comma outside of function arguments");
     }
 }
 
-std::vector<Token> Parser::parseToRPN(const std::vector<Token>& tokens) {
-    tokens_ = &tokens;
-    output_.clear();
-    while (!stack_.empty()) stack_.pop();
-    
-    for (const auto& token : tokens) {
-        switch (token.type) {
-            case TokenType::Number:
-            case TokenType::Constant:
-            case TokenType::Variable:
-                output_.push_back(token);
-                break;
-                
-            case TokenType::Function:
-                handleFunction(token);
-                break;
-                
-            case TokenType::Operator:
-                handleOperator(token);
-                break;
-                
-            case TokenType::LeftBracket:
-                handleLeftBracket(token);
-                break;
-                
-            case TokenType::RightBracket:
-                handleRightBracket(token);
-                break;
-                
-            case TokenType::Comma:
-                // Пока не поддерживаем функции с несколькими аргументами
-                throw SyntaxError("Comma not supported");
-                break;
-                
-            default:
-                throw SyntaxError("Unknown token type");
-        }
+void Parser::handleComma() {
+    // Аргумент функции закончен: выталкиваем операторы до открывающей скобки
+    while (!stack_.empty() && stack_.top().type != TokenType::LeftBracket) {
+        output_.push_back(std::move(stack_.top()));
+        stack_.pop();
     }
     
+    if (stack_.empty()) {
+        throw SyntaxError("Comma outside of function arguments");
+    }
+    ++arguments_.top();
+}
+
+void Parser::handleToken(Token&& token) {
+    switch (token.type) {
+        case TokenType::Number:
+        case TokenType::Constant:
+        case TokenType::Variable:
+            output_.push_back(std::move(token));
+            break;
+            
+        case TokenType::Function:
+            handleFunction(std::move(token));
+            break;
+            
+        case TokenType::Operator:
+            handleOperator(std::move(token));
+            break;
+            
+        case TokenType::LeftBracket:
+            handleLeftBracket(std::move(token));
+            break;
+            
+        case TokenType::RightBracket:
+            handleRightBracket(token);
+            break;
+            
+        case TokenType::Comma:
+            handleComma();
+            break;
+            
+        default:
+            throw SyntaxError("Unknown token type");
+    }
+}
+
+void Parser::begin() {
+    output_.clear();
+    while (!stack_.empty()) stack_.pop();
+    while (!arguments_.empty()) arguments_.pop();
+}
+
+std::vector<Token> Parser::finish() {
     while (!stack_.empty()) {
-        Token top = stack_.top();
-        stack_.pop();
+        Token& top = stack_.top();
         
         if (top.type == TokenType::LeftBracket) {
             throw SyntaxError("Mismatched brackets");
         }
-        output_.push_back(top);
+        output_.push_back(std::move(top));
+        stack_.pop();
     }
     
-    return output_;
-}
\ No newline at end of file
+    return std::move(output_);
+}
+
+std::vector<Token> Parser::parseToRPN(const std::vector<Token>& tokens) {
+    begin();
+    output_.reserve(tokens.size());
+    
+    for (const auto& token : tokens) {
+        handleToken(Token(token));
+    }
+    
+    return finish();
+}
+
+std::vector<Token> Parser::parseToRPN(Lexer& lexer) {
+    begin();
+    
+    Token token(0.0);
+    while (lexer.next(token)) {
+        handleToken(std::move(token));
+    }
+    
+    return finish();
+}
+
+std::vector<Token> Parser::parseToRPN(std::istream& input) {
+    Lexer lexer;
+    lexer.reset(input);
+    return parseToRPN(lexer);
+}
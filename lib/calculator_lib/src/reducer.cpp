@@ -0,0 +1,212 @@
+#include "../include/reducer.h"
+#include "../include/error.h"
+#include <cmath>
+#include <limits>
+#include <sstream>
+
+namespace {
+
+// Суммирование Ноймайера: потерянные младшие разряды копятся в compensation.
+// После переполнения или inf/NaN поправка теряет смысл (inf - inf = NaN) и не
+// копится: сумма и так уже не конечна
+void neumaierAdd(double& sum, double& compensation, double value) {
+    double t = sum + value;
+    if (!std::isfinite(t)) {
+        sum = t;
+        return;
+    }
+    if (std::fabs(sum) >= std::fabs(value)) {
+        compensation += (sum - t) + value;
+    } else {
+        compensation += (value - t) + sum;
+    }
+    sum = t;
+}
+
+constexpr size_t kLanes = 4;
+
+// Сумма блока в kLanes независимых дорожках: цепочка зависимостей по сумме
+// короче в kLanes раз. Ошибка каждого сложения точная (TwoSum, без ветвлений),
+// итоги дорожек складываются в общую компенсированную сумму
+void compensatedSum(const double* values, size_t count, double& sum, double& compensation) {
+    double sums[kLanes] = {};
+    double errors[kLanes] = {};
+
+    auto twoSum = [&](size_t lane, double value) {
+        double t = sums[lane] + value;
+        double z = t - sums[lane];
+        errors[lane] += (sums[lane] - (t - z)) + (value - z);
+        sums[lane] = t;
+    };
+
+    size_t i = 0;
+    for (; i + kLanes <= count; i += kLanes) {
+        for (size_t k = 0; k < kLanes; ++k) {
+            twoSum(k, values[i + k]);
+        }
+    }
+    for (; i < count; ++i) {
+        twoSum(0, values[i]);
+    }
+
+    for (size_t k = 0; k < kLanes; ++k) {
+        neumaierAdd(sum, compensation, sums[k]);
+        // NaN: дорожка прошла через inf, сумма не конечна и без поправки
+        if (std::isfinite(errors[k])) compensation += errors[k];
+    }
+}
+
+// Минимум или максимум по дорожкам: pick(value, best) выбирает без ветвления,
+// NaN пропускается
+template <typename Pick>
+double extremum(const double* values, size_t count, double best, Pick pick) {
+    double lanes[kLanes];
+    for (size_t k = 0; k < kLanes; ++k) lanes[k] = best;
+
+    size_t i = 0;
+    for (; i + kLanes <= count; i += kLanes) {
+        for (size_t k = 0; k < kLanes; ++k) {
+            lanes[k] = pick(values[i + k], lanes[k]);
+        }
+    }
+    for (; i < count; ++i) {
+        lanes[0] = pick(values[i], lanes[0]);
+    }
+
+    for (size_t k = 0; k < kLanes; ++k) {
+        best = pick(lanes[k], best);
+    }
+    return best;
+}
+
+double parseNumber(const std::string& text, const std::string& spec) {
+    try {
+        size_t used = 0;
+        double value = std::stod(text, &used);
+        if (used == text.size()) return value;
+    } catch (...) {
+    }
+    throw SyntaxError("Invalid reduction: " + spec);
+}
+
+} // namespace
+
+ReduceSpec ReduceSpec::parse(const std::string& spec) {
+    ReduceSpec result;
+    std::stringstream items(spec);
+    std::string item;
+
+    while (std::getline(items, item, ',')) {
+        if (item == "sum") {
+            result.sum = true;
+        } else if (item == "min") {
+            result.min = true;
+        } else if (item == "max") {
+            result.max = true;
+        } else if (item == "mean") {
+            result.mean = true;
+        } else if (item.rfind("hist:", 0) == 0) {
+            std::vector<std::string> parts;
+            std::stringstream fields(item.substr(5));
+            std::string field;
+            while (std::getline(fields, field, ':')) {
+                parts.push_back(field);
+            }
+            if (parts.size() != 1 && parts.size() != 3) {
+                throw SyntaxError("Invalid reduction: " + item);
+            }
+
+            double bins = parseNumber(parts[0], item);
+            if (bins < 1 || std::floor(bins) != bins) {
+                throw SyntaxError("Invalid reduction: " + item);
+            }
+            result.histBins = static_cast<size_t>(bins);
+
+            if (parts.size() == 3) {
+                result.histRange = true;
+                result.histLow = parseNumber(parts[1], item);
+                result.histHigh = parseNumber(parts[2], item);
+                if (!(result.histLow <= result.histHigh)) {
+                    throw SyntaxError("Invalid reduction: " + item);
+                }
+            }
+        } else {
+            throw SyntaxError("Invalid reduction: " + item);
+        }
+    }
+
+    return result;
+}
+
+Accumulator::Accumulator(const ReduceSpec& spec)
+    : spec_(spec),
+      min_(std::numeric_limits<double>::infinity()),
+      max_(-std::numeric_limits<double>::infinity()) {
+    if (spec.histBins > 0) {
+        if (!spec.histRange) {
+            throw RuntimeError("Histogram range is not set");
+        }
+        histogram_.assign(spec.histBins, 0);
+    }
+}
+
+void Accumulator::addSum(double value) {
+    neumaierAdd(sum_, compensation_, value);
+}
+
+void Accumulator::add(const double* values, size_t count) {
+    if (count == 0) return;
+
+    count_ += count;
+
+    if (spec_.sum || spec_.mean) {
+        compensatedSum(values, count, sum_, compensation_);
+    }
+
+    if (spec_.min) {
+        min_ = extremum(values, count, min_, [](double v, double best) { return v < best ? v : best; });
+    }
+    if (spec_.max) {
+        max_ = extremum(values, count, max_, [](double v, double best) { return v > best ? v : best; });
+    }
+
+    if (histogram_.empty()) return;
+
+    size_t bins = histogram_.size();
+    double histLow = spec_.histLow;
+    double histHigh = spec_.histHigh;
+    double width = histHigh - histLow;
+    double scale = width > 0 ? bins / width : 0;
+    for (size_t i = 0; i < count; ++i) {
+        double v = values[i];
+        if (!(v >= histLow && v <= histHigh)) {
+            ++outOfRange_;
+            continue;
+        }
+        size_t bin = static_cast<size_t>((v - histLow) * scale);
+        ++histogram_[bin < bins ? bin : bins - 1];
+    }
+}
+
+void Accumulator::merge(const Accumulator& other) {
+    if (other.histogram_.size() != histogram_.size() ||
+        other.spec_.histLow != spec_.histLow || other.spec_.histHigh != spec_.histHigh) {
+        throw RuntimeError("Cannot merge histograms with different bins");
+    }
+
+    count_ += other.count_;
+    addSum(other.sum_);
+    addSum(other.compensation_);
+    min_ = other.min_ < min_ ? other.min_ : min_;
+    max_ = other.max_ > max_ ? other.max_ : max_;
+
+    for (size_t i = 0; i < histogram_.size(); ++i) {
+        histogram_[i] += other.histogram_[i];
+    }
+    outOfRange_ += other.outOfRange_;
+}
+
+double Accumulator::mean() const {
+    if (count_ == 0) return std::numeric_limits<double>::quiet_NaN();
+    return sum() / static_cast<double>(count_);
+}
@@ -0,0 +1,154 @@
+#include "../include/window.h"
+#include "../include/error.h"
+#include <cmath>
+#include <limits>
+
+WindowState::WindowState(const std::string& function, double parameter)
+    : parameter_(parameter) {
+    if (function == "ema") {
+        if (!(parameter > 0 && parameter <= 1)) {
+            throw MathError("ema requires smoothing factor in (0, 1]");
+        }
+        kind_ = Kind::Ema;
+        alpha_ = parameter;
+        return;
+    }
+
+    if (function == "rolling_mean") {
+        kind_ = Kind::Mean;
+    } else if (function == "rolling_min") {
+        kind_ = Kind::Min;
+    } else if (function == "rolling_max") {
+        kind_ = Kind::Max;
+    } else if (function == "lag") {
+        kind_ = Kind::Lag;
+    } else {
+        throw RuntimeError("Unknown window function: " + function);
+    }
+
+    bool valid = std::floor(parameter) == parameter &&
+                 (kind_ == Kind::Lag ? parameter >= 0 : parameter >= 1);
+    if (!valid) {
+        throw MathError(function + " requires " +
+                        (kind_ == Kind::Lag ? "non-negative" : "positive") + " integer window");
+    }
+    if (parameter > static_cast<double>(kMaxSize)) {
+        throw MathError(function + " window is too large (max " + std::to_string(kMaxSize) + " rows)");
+    }
+    size_ = static_cast<size_t>(parameter);
+
+    if (kind_ == Kind::Min || kind_ == Kind::Max) {
+        dequeIndex_.resize(size_);
+        dequeValue_.resize(size_);
+    } else {
+        ring_.resize(size_);
+    }
+}
+
+double WindowState::push(double value, bool& divisionByZero) {
+    divisionByZero = pushFlag(divisionByZero);
+
+    switch (kind_) {
+        case Kind::Mean: return pushMean(value);
+        case Kind::Min:
+        case Kind::Max: return pushExtremum(value);
+        case Kind::Lag: return pushLag(value);
+        case Kind::Ema:
+            ema_ = (count_++ == 0) ? value : alpha_ * value + (1 - alpha_) * ema_;
+            return ema_;
+    }
+    return value;
+}
+
+// Вызывается до сдвига окна (count_ еще не увеличен), возвращает флаг результата
+bool WindowState::pushFlag(bool divisionByZero) {
+    if (kind_ == Kind::Ema) {
+        emaDivisionByZero_ = emaDivisionByZero_ || divisionByZero;
+        return emaDivisionByZero_;
+    }
+    if (size_ == 0) {
+        return divisionByZero; // lag(x, 0) возвращает само значение
+    }
+    if (flags_.empty()) {
+        if (!divisionByZero) return false;
+        flags_.assign(size_, 0);
+    }
+
+    size_t pos = count_ % size_;
+    bool leaving = count_ >= size_ && flags_[pos];
+    flaggedCount_ = flaggedCount_ - leaving + divisionByZero;
+    flags_[pos] = divisionByZero;
+    return kind_ == Kind::Lag ? leaving : flaggedCount_ > 0;
+}
+
+double WindowState::pushMean(double value) {
+    // Учет значения в окне: конечные - в сумму, остальные - в счетчики
+    auto account = [this](double v, bool entering) {
+        if (std::isfinite(v)) {
+            sum_ += entering ? v : -v;
+            return;
+        }
+        size_t& counter = std::isnan(v) ? nanCount_ : v > 0 ? positiveInfCount_ : negativeInfCount_;
+        counter = entering ? counter + 1 : counter - 1;
+    };
+
+    size_t pos = count_ % size_;
+    if (count_ >= size_) {
+        account(ring_[pos], false);
+    }
+    ring_[pos] = value;
+    account(value, true);
+    ++count_;
+
+    // Раз в size_ строк сумма пересчитывается заново: ошибка округления
+    // от вычитаний не накапливается, а цена остается O(1) на строку
+    if (count_ % size_ == 0) {
+        sum_ = 0;
+        for (double v : ring_) {
+            if (std::isfinite(v)) sum_ += v;
+        }
+    }
+
+    if (nanCount_ > 0 || (positiveInfCount_ > 0 && negativeInfCount_ > 0)) {
+        return std::numeric_limits<double>::quiet_NaN();
+    }
+    if (positiveInfCount_ > 0) return std::numeric_limits<double>::infinity();
+    if (negativeInfCount_ > 0) return -std::numeric_limits<double>::infinity();
+
+    size_t n = count_ < size_ ? count_ : size_;
+    return sum_ / static_cast<double>(n);
+}
+
+double WindowState::pushExtremum(double value) {
+    size_t capacity = size_;
+    size_t index = count_++;
+
+    // Выбрасываем строки, вышедшие из окна
+    while (head_ != tail_ && dequeIndex_[head_ % capacity] + size_ <= index) {
+        ++head_;
+    }
+    // И значения, которые уже никогда не станут экстремумом
+    while (head_ != tail_) {
+        double back = dequeValue_[(tail_ - 1) % capacity];
+        if (kind_ == Kind::Min ? back >= value : back <= value) {
+            --tail_;
+        } else {
+            break;
+        }
+    }
+    dequeIndex_[tail_ % capacity] = index;
+    dequeValue_[tail_ % capacity] = value;
+    ++tail_;
+
+    return dequeValue_[head_ % capacity];
+}
+
+double WindowState::pushLag(double value) {
+    if (size_ == 0) return value;
+
+    size_t pos = count_ % size_;
+    double result = (count_ >= size_) ? ring_[pos] : std::numeric_limits<double>::quiet_NaN();
+    ring_[pos] = value;
+    ++count_;
+    return result;
+}
@@ -1,32 +1,213 @@
 #include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cmath>
 #include <calculator_lib.h>
 #include <CLI/CLI.hpp>
 
+// Строки входного CSV читаются порциями, чтобы память не зависела от размера файла
+static const size_t kChunkRows = 1 << 16;
+
+static std::vector<std::string> readHeader(std::istream& in) {
+    std::string line;
+    if (!std::getline(in, line)) {
+        throw RuntimeError("Input is empty");
+    }
+
+    std::vector<std::string> names;
+    std::stringstream fields(line);
+    std::string name;
+    while (std::getline(fields, name, ',')) {
+        // Пробелы вокруг имени и \r от CRLF-файлов к имени столбца не относятся
+        size_t first = name.find_first_not_of(" \t\r");
+        size_t last = name.find_last_not_of(" \t\r");
+        names.push_back(first == std::string::npos ? "" : name.substr(first, last - first + 1));
+    }
+    return names;
+}
+
+static size_t readRows(std::istream& in, std::vector<std::vector<double>>& columns) {
+    size_t rows = 0;
+    std::string line;
+
+    while (rows < kChunkRows && std::getline(in, line)) {
+        if (line.empty()) continue;
+
+        const char* p = line.c_str();
+        for (size_t col = 0; col < columns.size(); ++col) {
+            char* end = nullptr;
+            double value = std::strtod(p, &end);
+            if (end == p || (*end != ',' && *end != '\0' && *end != '\r')) {
+                throw SyntaxError("Invalid input row: " + line);
+            }
+            columns[col][rows] = value;
+            p = (*end == ',') ? end + 1 : end;
+        }
+        ++rows;
+    }
+    return rows;
+}
+
+// Проход по входу порциями: столбцы привязываются к evaluator, onChunk получает число строк
+template <typename OnChunk>
+static void forEachChunk(std::istream& in, BatchEvaluator& batch, OnChunk&& onChunk) {
+    auto names = readHeader(in);
+    std::vector<std::vector<double>> columns(names.size(), std::vector<double>(kChunkRows));
+    for (size_t col = 0; col < names.size(); ++col) {
+        batch.setColumn(names[col], columns[col].data());
+    }
+
+    size_t rows;
+    while ((rows = readRows(in, columns)) > 0) {
+        onChunk(rows);
+    }
+}
+
+static void printReduction(const Accumulator& acc) {
+    const ReduceSpec& spec = acc.spec();
+    if (spec.sum) std::cout << "sum: " << acc.sum() << std::endl;
+    if (spec.min) std::cout << "min: " << acc.min() << std::endl;
+    if (spec.max) std::cout << "max: " << acc.max() << std::endl;
+    if (spec.mean) std::cout << "mean: " << acc.mean() << std::endl;
+
+    const auto& histogram = acc.histogram();
+    double width = (spec.histHigh - spec.histLow) / histogram.size();
+    for (size_t i = 0; i < histogram.size(); ++i) {
+        std::cout << "hist [" << spec.histLow + i * width << ", "
+                  << spec.histLow + (i + 1) * width << "): " << histogram[i] << std::endl;
+    }
+    if (acc.outOfRange() > 0) {
+        std::cout << "hist out of range: " << acc.outOfRange() << std::endl;
+    }
+}
+
 int main(int argc, char** argv) {
     CLI::App app{"RPN Calculator"};
     
     std::string expression;
-    app.add_option("expression", expression, "Mathematical expression")->required();
+    auto* expressionOpt = app.add_option("expression", expression, "Mathematical expression");
+    
+    std::string file;
+    app.add_option("--file,-f", file, "Read expression from file ('-' for stdin)")
+        ->excludes(expressionOpt);
     
     std::map<std::string, double> variables;
     app.add_option("--var,-v", variables, "Set variables (e.g., x=3.14)");
     
+    std::string input;
+    app.add_option("--input,-i", input, "Evaluate for every row of a CSV file with a header ('-' for stdin)");
+    
+    std::string reduce;
+    app.add_option("--reduce,-r", reduce, "Aggregate results over rows (e.g., sum,min,max,mean,hist:64)");
+    
+    unsigned threads = 0;
+    app.add_option("--threads,-j", threads, "Threads for row evaluation (0 = all cores)");
+    
     CLI11_PARSE(app, argc, argv);
     
+    if (file.empty() && !*expressionOpt) {
+        std::cerr << "Error: expression or --file is required" << std::endl;
+        return 1;
+    }
+    if (!reduce.empty() && input.empty()) {
+        std::cerr << "Error: --reduce requires --input" << std::endl;
+        return 1;
+    }
+    if (file == "-" && input == "-") {
+        std::cerr << "Error: expression and input cannot both be read from stdin" << std::endl;
+        return 1;
+    }
+    
     try {
-        Lexer lexer;
-        auto tokens = lexer.tokenize(expression);
-        
         Parser parser;
-        auto rpnTokens = parser.parseToRPN(tokens);
+        std::vector<Token> rpnTokens;
+        
+        if (!file.empty()) {
+            // Большие выражения читаются потоково, без загрузки в память целиком
+            std::ifstream in;
+            if (file != "-") {
+                in.open(file);
+                if (!in) {
+                    std::cerr << "Error: cannot open file " << file << std::endl;
+                    return 1;
+                }
+            }
+            rpnTokens = parser.parseToRPN(file == "-" ? std::cin : in);
+        } else {
+            Lexer lexer;
+            auto tokens = lexer.tokenize(expression);
+            rpnTokens = parser.parseToRPN(tokens);
+        }
+        
+        if (input.empty()) {
+            Evaluator evaluator;
+            for (const auto& [name, value] : variables) {
+                evaluator.setVariable(name, value);
+            }
+            
+            double result = evaluator.evaluateRPN(rpnTokens);
+            std::cout << "Result: " << result << std::endl;
+            return 0;
+        }
+        
+        std::ifstream inputFile;
+        if (input != "-") {
+            inputFile.open(input);
+            if (!inputFile) {
+                std::cerr << "Error: cannot open file " << input << std::endl;
+                return 1;
+            }
+        }
+        std::istream& rows = (input == "-") ? std::cin : inputFile;
         
-        Evaluator evaluator;
+        BatchEvaluator batch;
         for (const auto& [name, value] : variables) {
-            evaluator.setVariable(name, value);
+            batch.setVariable(name, value);
+        }
+        
+        if (reduce.empty()) {
+            std::vector<double> results(kChunkRows);
+            forEachChunk(rows, batch, [&](size_t count) {
+                batch.evaluateRPN(rpnTokens, count, results.data(), threads);
+                for (size_t i = 0; i < count; ++i) {
+                    std::cout << results[i] << '\n';
+                }
+            });
+            return 0;
+        }
+        
+        ReduceSpec spec = ReduceSpec::parse(reduce);
+        
+        // Гистограмма без явного диапазона: первый проход находит min/max
+        if (spec.histBins > 0 && !spec.histRange) {
+            if (input == "-") {
+                std::cerr << "Error: histogram over stdin needs a range (hist:BINS:LOW:HIGH)" << std::endl;
+                return 1;
+            }
+            
+            Accumulator bounds(ReduceSpec::parse("min,max"));
+            forEachChunk(rows, batch, [&](size_t count) {
+                batch.reduceRPN(rpnTokens, count, bounds, threads);
+            });
+            if (bounds.count() == 0 || !std::isfinite(bounds.min()) || !std::isfinite(bounds.max())) {
+                std::cerr << "Error: cannot choose histogram range: no finite results "
+                          << "(use hist:BINS:LOW:HIGH)" << std::endl;
+                return 1;
+            }
+            spec.histRange = true;
+            spec.histLow = bounds.min();
+            spec.histHigh = bounds.max();
+            
+            inputFile.clear();
+            inputFile.seekg(0);
+            batch.resetState();
         }
         
-        double result = evaluator.evaluateRPN(rpnTokens);
-        std::cout << "Result: " << result << std::endl;
+        Accumulator accumulator(spec);
+        forEachChunk(rows, batch, [&](size_t count) {
+            batch.reduceRPN(rpnTokens, count, accumulator, threads);
+        });
+        printReduction(accumulator);
         
     } catch (const CalcError& e) {
         std::cerr << "Error: " << e.what() << std::endl;
@@ -34,4 +215,4 @@ int main(int argc, char** argv) {
     }
     
     return 0;
-}
\ No newline at end of file
+}
@@ -2,6 +2,8 @@
 #include <catch2/catch_all.hpp>
 #include <calculator_lib.h>
 #include <cmath>
+#include <limits>
+#include <sstream>
 
 using Catch::Approx;
 
@@ -55,8 +57,26 @@ TEST_CASE("Lexer tokenization", "[lexer]") {
         CHECK(tokens[5].lexeme == "}");
     }
     
+    SECTION("Comparison and logical operators") {
+        auto tokens = lexer.tokenize("< <= > >= == != && ||");
+        REQUIRE(tokens.size() == 8);
+        CHECK(tokens[0].lexeme == "<");
+        CHECK(tokens[1].lexeme == "<=");
+        CHECK(tokens[2].lexeme == ">");
+        CHECK(tokens[3].lexeme == ">=");
+        CHECK(tokens[4].lexeme == "==");
+        CHECK(tokens[5].lexeme == "!=");
+        CHECK(tokens[6].lexeme == "&&");
+        CHECK(tokens[7].lexeme == "||");
+        for (const auto& token : tokens) {
+            CHECK(token.type == TokenType::Operator);
+        }
+    }
+    
     SECTION("Invalid characters") {
         REQUIRE_THROWS_AS(lexer.tokenize("3 @ 4"), SyntaxError);
+        REQUIRE_THROWS_AS(lexer.tokenize("3 = 4"), SyntaxError);
+        REQUIRE_THROWS_AS(lexer.tokenize("3 & 4"), SyntaxError);
     }
 }
 
@@ -101,6 +121,23 @@ TEST_CASE("Parser RPN conversion", "[parser]") {
         CHECK(toRPNString("2 ^ 3 ^ 2") == "2 3 2 ^ ^");
     }
     
+    SECTION("Comparisons and conditional") {
+        CHECK(toRPNString("x + 1 < y * 2") == "x 1 + y 2 * <");
+        CHECK(toRPNString("a < b && c == d || e") == "a b < c d == && e ||");
+        CHECK(toRPNString("if(x > 0, x, -x)") == "x 0 > x x unary_minus if");
+        CHECK(toRPNString("if(a, if(b, 1, 2), 3)") == "a b 1 2 if 3 if");
+        REQUIRE_THROWS_AS(parser.parseToRPN(lexer.tokenize("1, 2")), SyntaxError);
+    }
+    
+    SECTION("Argument count") {
+        CHECK(toRPNString("lag(x, 1)") == "x 1 lag");
+        // Лишний аргумент одного вызова не должен компенсировать недостающий в другом
+        for (const char* expr : {"sin(1, 2) + if(3, 4)", "cos(1, 2, 3) * if(5)", "(1, 2) + if(3, 4)",
+                                 "if(1, (2, 3), 4)", "not(1, 2)", "lag(x)", "ema(x, 1, 2)"}) {
+            REQUIRE_THROWS_AS(parser.parseToRPN(lexer.tokenize(expr)), SyntaxError);
+        }
+    }
+    
     SECTION("Brackets matching") {
         CHECK(toRPNString("(2 + 3) * 4") == "2 3 + 4 *");
         REQUIRE_THROWS_AS(parser.parseToRPN(lexer.tokenize("(2 + 3]")), SyntaxError);
@@ -149,6 +186,27 @@ TEST_CASE("Evaluator computation", "[evaluator]") {
         CHECK(evalExpr("sin(x)", {{"x", M_PI/2}}) == Approx(1).margin(1e-5));
     }
     
+    SECTION("Comparisons and logic") {
+        CHECK(evalExpr("1 < 2") == 1);
+        CHECK(evalExpr("2 <= 2") == 1);
+        CHECK(evalExpr("1 > 2") == 0);
+        CHECK(evalExpr("2 >= 3") == 0);
+        CHECK(evalExpr("2 + 2 == 4") == 1);
+        CHECK(evalExpr("2 != 2") == 0);
+        CHECK(evalExpr("1 < 2 && 3 < 2") == 0);
+        CHECK(evalExpr("1 < 2 || 3 < 2") == 1);
+        CHECK(evalExpr("not(1 > 2)") == 1);
+    }
+    
+    SECTION("Conditional") {
+        CHECK(evalExpr("if(1, 2, 3)") == 2);
+        CHECK(evalExpr("if(0, 2, 3)") == 3);
+        CHECK(evalExpr("if(x > 10, 10, if(x < 0, 0, x))", {{"x", 15}}) == 10);
+        CHECK(evalExpr("if(x > 10, 10, if(x < 0, 0, x))", {{"x", -3}}) == 0);
+        CHECK(evalExpr("if(x > 10, 10, if(x < 0, 0, x))", {{"x", 4}}) == 4);
+        CHECK(evalExpr("2 * if(x >= 100, x * 0.9, x) + 1", {{"x", 200}}) == 361);
+    }
+    
     SECTION("Complex expressions") {
         CHECK(evalExpr("2 + 3 * 4") == 14);
         CHECK(evalExpr("(2 + 3) * 4") == 20);
@@ -244,4 +302,624 @@ TEST_CASE("Full pipeline", "[integration]") {
         double expected = (2 + 3) * 4 / std::pow(2, 3);
         CHECK(result == Approx(expected).margin(1e-5));
     }
-}
\ No newline at end of file
+}
+
+TEST_CASE("Streaming pipeline", "[stream]") {
+    Parser parser;
+    Evaluator eval;
+
+    SECTION("Same RPN as vector pipeline") {
+        std::string expr = "2 + sin(x) / {3 + cos(x)} * PI - -4 ^ 2";
+        Lexer lexer;
+        auto expected = parser.parseToRPN(lexer.tokenize(expr));
+
+        std::istringstream input(expr);
+        auto rpn = parser.parseToRPN(input);
+
+        REQUIRE(rpn.size() == expected.size());
+        for (size_t i = 0; i < rpn.size(); ++i) {
+            CHECK(rpn[i].type == expected[i].type);
+            CHECK(rpn[i].lexeme == expected[i].lexeme);
+            CHECK(rpn[i].value == expected[i].value);
+        }
+    }
+
+    SECTION("Multi-megabyte expression") {
+        // ~1.1 млн слагаемых, числа и идентификаторы пересекают границы блоков чтения
+        std::string expr = "x";
+        for (int i = 0; i < 1100000; ++i) {
+            expr += (i % 2) ? " + 1.5" : " - x";
+        }
+        REQUIRE(expr.size() > 4 * 1024 * 1024);
+
+        std::istringstream input(expr);
+        auto rpn = parser.parseToRPN(input);
+        CHECK(rpn.size() == 2 * 1100000 + 1);
+
+        eval.setVariable("x", 2);
+        CHECK(eval.evaluateRPN(rpn) == Approx(2 + 550000 * (1.5 - 2)));
+    }
+
+    SECTION("Errors") {
+        std::istringstream brackets("(2 + 3");
+        REQUIRE_THROWS_AS(parser.parseToRPN(brackets), SyntaxError);
+
+        std::istringstream chars("3 @ 4");
+        REQUIRE_THROWS_AS(parser.parseToRPN(chars), SyntaxError);
+    }
+}
+
+TEST_CASE("Streaming pipeline benchmark", "[!benchmark]") {
+    std::string expr = "1";
+    for (int i = 0; i < 1000000; ++i) {
+        expr += " + 2 * (3 - 1)";
+    }
+
+    Lexer lexer;
+    Parser parser;
+
+    BENCHMARK("tokenize + parseToRPN") {
+        return parser.parseToRPN(lexer.tokenize(expr)).size();
+    };
+
+    BENCHMARK("parseToRPN(istream)") {
+        std::istringstream input(expr);
+        return parser.parseToRPN(input).size();
+    };
+}
+
+TEST_CASE("Batch evaluation", "[batch]") {
+    Lexer lexer;
+    Parser parser;
+    Evaluator eval;
+    BatchEvaluator batch;
+    
+    const size_t rows = 10000;
+    std::vector<double> x(rows);
+    for (size_t i = 0; i < rows; ++i) {
+        x[i] = static_cast<double>(i) / 100 - 50;
+    }
+    batch.setColumn("x", x.data());
+    batch.setVariable("k", 3);
+    eval.setVariable("k", 3);
+    
+    SECTION("Matches scalar evaluator") {
+        auto rpn = parser.parseToRPN(lexer.tokenize(
+            "if(x < -10, -10, if(x > 10, 10, x)) * k + sin(x) ^ 2 - (x >= 0 && x != 5)"));
+        
+        for (unsigned threads : {1u, 4u}) {
+            std::vector<double> out(rows);
+            batch.evaluateRPN(rpn, rows, out.data(), threads);
+            for (size_t i = 0; i < rows; i += 37) {
+                eval.setVariable("x", x[i]);
+                CHECK(out[i] == Approx(eval.evaluateRPN(rpn)));
+            }
+        }
+    }
+    
+    SECTION("Errors") {
+        std::vector<double> out(rows);
+        REQUIRE_THROWS_AS(batch.evaluateRPN(parser.parseToRPN(lexer.tokenize("1 / x")), rows, out.data(), 4), MathError);
+        REQUIRE_THROWS_AS(batch.evaluateRPN(parser.parseToRPN(lexer.tokenize("y + 1")), rows, out.data()), RuntimeError);
+    }
+}
+
+TEST_CASE("Fused reductions", "[reduce]") {
+    Lexer lexer;
+    Parser parser;
+    BatchEvaluator batch;
+    
+    SECTION("Spec parsing") {
+        auto spec = ReduceSpec::parse("sum,min,max,mean,hist:64");
+        CHECK(spec.sum);
+        CHECK(spec.min);
+        CHECK(spec.max);
+        CHECK(spec.mean);
+        CHECK(spec.histBins == 64);
+        CHECK(!spec.histRange);
+        
+        auto ranged = ReduceSpec::parse("hist:4:0:2");
+        CHECK(ranged.histRange);
+        CHECK(ranged.histLow == 0);
+        CHECK(ranged.histHigh == 2);
+        
+        REQUIRE_THROWS_AS(ReduceSpec::parse("median"), SyntaxError);
+        REQUIRE_THROWS_AS(ReduceSpec::parse("hist:0"), SyntaxError);
+        REQUIRE_THROWS_AS(ReduceSpec::parse("hist:4:1"), SyntaxError);
+    }
+    
+    SECTION("Sum, min, max, mean over rows") {
+        const size_t rows = 1000001;
+        std::vector<double> x(rows);
+        for (size_t i = 0; i < rows; ++i) x[i] = static_cast<double>(i);
+        batch.setColumn("x", x.data());
+        
+        for (unsigned threads : {1u, 3u, 8u}) {
+            Accumulator acc(ReduceSpec::parse("sum,min,max,mean"));
+            batch.reduceRPN(parser.parseToRPN(lexer.tokenize("x * 2 + 1")), rows, acc, threads);
+            CHECK(acc.count() == rows);
+            CHECK(acc.sum() == 1000001.0 * 1000001.0);
+            CHECK(acc.min() == 1);
+            CHECK(acc.max() == 2000001);
+            CHECK(acc.mean() == 1000001);
+        }
+    }
+    
+    SECTION("Compensated summation") {
+        // Наивная сумма теряет все единицы на фоне 1e16
+        const size_t rows = 100001;
+        std::vector<double> x(rows, 1.0);
+        x[0] = 1e16;
+        batch.setColumn("x", x.data());
+        
+        Accumulator acc(ReduceSpec::parse("sum"));
+        batch.reduceRPN(parser.parseToRPN(lexer.tokenize("x")), rows, acc, 4);
+        CHECK(acc.sum() == 1e16 + (rows - 1));
+    }
+    
+    SECTION("Infinite values and overflow") {
+        // Поправка inf - inf не должна превращать сумму в NaN
+        auto sumOf = [](std::vector<double> values) {
+            Accumulator acc(ReduceSpec::parse("sum,mean"));
+            acc.add(values.data(), values.size());
+            return acc.sum();
+        };
+        const double inf = std::numeric_limits<double>::infinity();
+        CHECK(sumOf({1e308, 1e308}) == inf);
+        CHECK(sumOf({1, inf, 2}) == inf);
+        CHECK(sumOf({-1e308, -1e308, 5}) == -inf);
+        CHECK(std::isnan(sumOf({inf, -inf})));
+        CHECK(std::isnan(sumOf({1, NAN})));
+        
+        Accumulator left(ReduceSpec::parse("sum"));
+        Accumulator right(ReduceSpec::parse("sum"));
+        std::vector<double> big = {1e308, 1e308};
+        std::vector<double> ones(300, 1.0);
+        left.add(big.data(), big.size());
+        right.add(ones.data(), ones.size());
+        right.merge(left);
+        CHECK(right.sum() == inf);
+    }
+    
+    SECTION("Only requested aggregates") {
+        std::vector<double> values = {3, -1, 2};
+        Accumulator acc(ReduceSpec::parse("max"));
+        acc.add(values.data(), values.size());
+        CHECK(acc.count() == 3);
+        CHECK(acc.max() == 3);
+    }
+    
+    SECTION("Histogram") {
+        std::vector<double> x = {0, 0.5, 1, 1.5, 2, 3};
+        batch.setColumn("x", x.data());
+        
+        Accumulator acc(ReduceSpec::parse("hist:4:0:2"));
+        batch.reduceRPN(parser.parseToRPN(lexer.tokenize("x")), x.size(), acc, 2);
+        REQUIRE(acc.histogram().size() == 4);
+        CHECK(acc.histogram()[0] == 1);
+        CHECK(acc.histogram()[1] == 1);
+        CHECK(acc.histogram()[2] == 1);
+        CHECK(acc.histogram()[3] == 2);
+        CHECK(acc.outOfRange() == 1);
+        
+        REQUIRE_THROWS_AS(Accumulator(ReduceSpec::parse("hist:4")), RuntimeError);
+    }
+}
+
+TEST_CASE("Fused reduction benchmark", "[!benchmark]") {
+    Lexer lexer;
+    Parser parser;
+    BatchEvaluator batch;
+    
+    const size_t rows = 4000000;
+    std::vector<double> x(rows);
+    for (size_t i = 0; i < rows; ++i) x[i] = static_cast<double>(i % 1000) / 10;
+    batch.setColumn("x", x.data());
+    auto rpn = parser.parseToRPN(lexer.tokenize("if(x > 50, x * 0.9, x) + (x < 10) * 5"));
+    
+    BENCHMARK("materialize + sum") {
+        std::vector<double> out(rows);
+        batch.evaluateRPN(rpn, rows, out.data(), 0);
+        double sum = 0;
+        for (double v : out) sum += v;
+        return sum;
+    };
+    
+    BENCHMARK("reduce sum") {
+        Accumulator acc(ReduceSpec::parse("sum"));
+        batch.reduceRPN(rpn, rows, acc, 0);
+        return acc.sum();
+    };
+}
+
+TEST_CASE("Compile-time expressions", "[static]") {
+    Lexer lexer;
+    Parser parser;
+    Evaluator eval;
+    
+    SECTION("Parsed at compile time") {
+        constexpr auto f = CALC_STATIC_EXPR("(a + b) * c / (a ^ b)");
+        static_assert(f.arity == 3, "three variables");
+        static_assert(f.variable(0) == "a" && f.variable(1) == "b" && f.variable(2) == "c",
+                      "variables in order of first appearance");
+        CHECK(f(2, 3, 4) == Approx((2 + 3) * 4 / std::pow(2, 3)));
+    }
+    
+    SECTION("Same results as runtime pipeline") {
+        auto check = [&](const std::string& expr, auto f, double x) {
+            eval.setVariable("x", x);
+            CHECK(f(x) == Approx(eval.evaluateRPN(parser.parseToRPN(lexer.tokenize(expr)))));
+        };
+        
+        for (double x : {-3.0, 0.0, 0.5, 2.0, 11.0}) {
+            check("2 + sin(x) / {3 + cos(x)} * PI", CALC_STATIC_EXPR("2 + sin(x) / {3 + cos(x)} * PI"), x);
+            check("-x ^ 2 - --x", CALC_STATIC_EXPR("-x ^ 2 - --x"), x);
+            check("2 ^ x ^ 2", CALC_STATIC_EXPR("2 ^ x ^ 2"), x);
+            check("if(x > 10, 10, if(x < 0, 0, x)) + (x >= 0.5 && not(x == 2))",
+                  CALC_STATIC_EXPR("if(x > 10, 10, if(x < 0, 0, x)) + (x >= 0.5 && not(x == 2))"), x);
+            check("x * 0 + (3!) - 1.25", CALC_STATIC_EXPR("x * 0 + (3!) - 1.25"), x);
+            check("(x * 2 - 3) / 4 + x ^ 2 - 1 < 5 == 0", CALC_STATIC_EXPR("(x * 2 - 3) / 4 + x ^ 2 - 1 < 5 == 0"), x);
+        }
+    }
+    
+    SECTION("Constants only") {
+        constexpr auto f = CALC_STATIC_EXPR("2 * PI");
+        static_assert(f.arity == 0, "no variables");
+        CHECK(f() == 2 * M_PI);
+    }
+    
+    SECTION("Argument count") {
+        // Во время выполнения compile бросает те же ошибки, что в constexpr становятся ошибками компиляции
+        for (const char* expr : {"sin(1, 2) + if(3, 4)", "cos(1, 2, 3) * if(5)", "(1, 2) + if(3, 4)"}) {
+            REQUIRE_THROWS_AS(static_expression::compile<32>(expr), SyntaxError);
+        }
+        CHECK(static_expression::compile<32>("if(1, sin(2), 3)").size == 5);
+    }
+    
+    SECTION("Long chains") {
+        // Глубина шаблонов не зависит от длины цепочки a + b - c ...
+#define TERMS_10 "x - y + x - y + x - y + x - y + x - y + "
+#define TERMS_100 TERMS_10 TERMS_10 TERMS_10 TERMS_10 TERMS_10 TERMS_10 TERMS_10 TERMS_10 TERMS_10 TERMS_10
+        constexpr auto f = CALC_STATIC_EXPR(TERMS_100 TERMS_100 TERMS_100 TERMS_100 TERMS_100
+                                            TERMS_100 TERMS_100 TERMS_100 TERMS_100 TERMS_100 "x");
+#undef TERMS_100
+#undef TERMS_10
+        CHECK(f(3, 1) == 1003);
+    }
+}
+
+TEST_CASE("Compile-time expression benchmark", "[!benchmark]") {
+    const size_t rows = 1000000;
+    std::vector<double> x(rows), out(rows);
+    for (size_t i = 0; i < rows; ++i) x[i] = static_cast<double>(i % 1000) / 10;
+    
+    constexpr auto f = CALC_STATIC_EXPR("if(x > 50, x * 0.9, x) + (x < 10) * 5");
+    
+    BENCHMARK("hand-written") {
+        for (size_t i = 0; i < rows; ++i) {
+            double v = x[i];
+            out[i] = (v > 50 ? v * 0.9 : v) + (v < 10) * 5;
+        }
+        return out[rows - 1];
+    };
+    
+    BENCHMARK("CALC_STATIC_EXPR") {
+        for (size_t i = 0; i < rows; ++i) out[i] = f(x[i]);
+        return out[rows - 1];
+    };
+}
+
+TEST_CASE("Window functions", "[window]") {
+    Lexer lexer;
+    Parser parser;
+    
+    const size_t rows = 5000;
+    std::vector<double> x(rows);
+    for (size_t i = 0; i < rows; ++i) {
+        x[i] = std::sin(static_cast<double>(i) * 0.37) * 100 + static_cast<double>(i % 13);
+    }
+    
+    // Прямой пересчет окна для сравнения
+    auto naive = [&](const std::string& function, double parameter, size_t row) {
+        size_t n = static_cast<size_t>(parameter);
+        size_t first = (row + 1 >= n) ? row + 1 - n : 0;
+        if (function == "lag") {
+            return row >= n ? x[row - n] : NAN;
+        }
+        if (function == "ema") {
+            double ema = x[0];
+            for (size_t i = 1; i <= row; ++i) ema = parameter * x[i] + (1 - parameter) * ema;
+            return ema;
+        }
+        double result = x[first];
+        double sum = 0;
+        for (size_t i = first; i <= row; ++i) {
+            sum += x[i];
+            if (function == "rolling_min") result = std::min(result, x[i]);
+            if (function == "rolling_max") result = std::max(result, x[i]);
+        }
+        return function == "rolling_mean" ? sum / (row + 1 - first) : result;
+    };
+    
+    const std::vector<std::pair<std::string, double>> cases = {
+        {"rolling_mean", 20}, {"rolling_min", 7}, {"rolling_max", 50}, {"lag", 3}, {"ema", 0.1},
+    };
+    
+    SECTION("Streaming, one row per evaluateRPN") {
+        Evaluator eval;
+        for (const auto& [function, parameter] : cases) {
+            auto rpn = parser.parseToRPN(lexer.tokenize(function + "(x, " + std::to_string(parameter) + ")"));
+            eval.resetState();
+            for (size_t i = 0; i < 300; ++i) {
+                eval.setVariable("x", x[i]);
+                double expected = naive(function, parameter, i);
+                double actual = eval.evaluateRPN(rpn);
+                if (std::isnan(expected)) {
+                    CHECK(std::isnan(actual));
+                } else {
+                    CHECK(actual == Approx(expected));
+                }
+            }
+        }
+    }
+    
+    SECTION("Batch, state carries across chunks") {
+        for (const auto& [function, parameter] : cases) {
+            auto rpn = parser.parseToRPN(lexer.tokenize(function + "(x, n)"));
+            
+            // Весь ряд за один вызов и порциями неровного размера
+            BatchEvaluator whole;
+            whole.setColumn("x", x.data());
+            whole.setVariable("n", parameter);
+            std::vector<double> expected(rows);
+            whole.evaluateRPN(rpn, rows, expected.data(), 4);
+            
+            BatchEvaluator chunked;
+            chunked.setVariable("n", parameter);
+            std::vector<double> actual(rows);
+            for (size_t begin = 0; begin < rows; begin += 777) {
+                size_t count = std::min<size_t>(777, rows - begin);
+                chunked.setColumn("x", x.data() + begin);
+                chunked.evaluateRPN(rpn, count, actual.data() + begin, 4);
+            }
+            
+            for (size_t i = 0; i < rows; i += 11) {
+                double reference = naive(function, parameter, i);
+                if (std::isnan(reference)) {
+                    CHECK(std::isnan(expected[i]));
+                    CHECK(std::isnan(actual[i]));
+                } else {
+                    CHECK(expected[i] == Approx(reference));
+                    CHECK(actual[i] == Approx(reference));
+                }
+            }
+        }
+    }
+    
+    SECTION("In expressions") {
+        auto rpn = parser.parseToRPN(lexer.tokenize("if(x > rolling_mean(x, 20), x - lag(x, 1), 0)"));
+        
+        // Построчный Evaluator - эталон для пакетного вычисления
+        Evaluator eval;
+        std::vector<double> expected(rows);
+        for (size_t i = 0; i < rows; ++i) {
+            eval.setVariable("x", x[i]);
+            expected[i] = eval.evaluateRPN(rpn);
+        }
+        
+        BatchEvaluator batch;
+        batch.setColumn("x", x.data());
+        std::vector<double> single(rows);
+        std::vector<double> parallel(rows);
+        batch.evaluateRPN(rpn, rows, single.data(), 1);
+        batch.resetState();
+        batch.evaluateRPN(rpn, rows, parallel.data(), 8);
+        
+        for (size_t i = 0; i < rows; ++i) {
+            if (std::isnan(expected[i])) {
+                CHECK(std::isnan(single[i]));
+                CHECK(std::isnan(parallel[i]));
+            } else {
+                CHECK(single[i] == expected[i]);
+                CHECK(parallel[i] == expected[i]);
+            }
+        }
+        
+        // Программа с состоянием дает один и тот же результат при любом числе потоков
+        Accumulator one(ReduceSpec::parse("sum,min,max"));
+        Accumulator eight(ReduceSpec::parse("sum,min,max"));
+        batch.resetState();
+        batch.reduceRPN(rpn, rows, one, 1);
+        batch.resetState();
+        batch.reduceRPN(rpn, rows, eight, 8);
+        CHECK(eight.count() == rows);
+        CHECK(eight.sum() == one.sum());
+        CHECK(eight.min() == one.min());
+        CHECK(eight.max() == one.max());
+    }
+    
+    SECTION("Another expression without resetState") {
+        // Состояние принадлежит выражению: другое выражение начинает ряд заново
+        auto mean = parser.parseToRPN(lexer.tokenize("rolling_mean(x, 3)"));
+        auto lag = parser.parseToRPN(lexer.tokenize("lag(x, 1)"));
+        
+        Evaluator eval;
+        for (double v : {10.0, 15.0, 20.0}) {
+            eval.setVariable("x", v);
+            eval.evaluateRPN(mean);
+        }
+        eval.setVariable("x", 1);
+        CHECK(std::isnan(eval.evaluateRPN(lag)));
+        eval.setVariable("x", 2);
+        CHECK(eval.evaluateRPN(lag) == 1);
+        
+        std::vector<double> series = {1, 2, 3, 4};
+        std::vector<double> out(series.size());
+        BatchEvaluator batch;
+        batch.setColumn("x", series.data());
+        batch.evaluateRPN(parser.parseToRPN(lexer.tokenize("rolling_max(x, 2)")), series.size(), out.data());
+        CHECK(out == std::vector<double>{1, 2, 3, 4});
+        batch.evaluateRPN(lag, series.size(), out.data());
+        CHECK(std::isnan(out[0]));
+        CHECK(std::vector<double>(out.begin() + 1, out.end()) == std::vector<double>{1, 2, 3});
+        
+        // Та же функция на той же позиции, но над другой переменной
+        auto lagY = parser.parseToRPN(lexer.tokenize("lag(y, 1)"));
+        eval.setVariable("x", 42);
+        eval.evaluateRPN(lag);
+        eval.setVariable("y", 7);
+        CHECK(std::isnan(eval.evaluateRPN(lagY)));
+        CHECK(eval.evaluateRPN(lagY) == 7);
+        
+        batch.setColumn("y", x.data());
+        batch.evaluateRPN(lagY, series.size(), out.data());
+        CHECK(std::isnan(out[0]));
+        CHECK(out[1] == x[0]);
+    }
+    
+    SECTION("Non-finite values") {
+        // inf и NaN, вышедшие из окна, не портят скользящее среднее
+        auto meanOf = [&](std::vector<double> series, size_t n) {
+            BatchEvaluator batch;
+            batch.setColumn("x", series.data());
+            batch.setVariable("n", static_cast<double>(n));
+            std::vector<double> out(series.size());
+            batch.evaluateRPN(parser.parseToRPN(lexer.tokenize("rolling_mean(x, n)")), series.size(), out.data());
+            return out;
+        };
+        const double inf = std::numeric_limits<double>::infinity();
+        
+        auto withNaN = meanOf({1, NAN, 1, 1, 1}, 3);
+        CHECK(withNaN[0] == 1);
+        CHECK(std::isnan(withNaN[1]));
+        CHECK(std::isnan(withNaN[3]));
+        CHECK(withNaN[4] == 1);
+        
+        auto withInf = meanOf({1, inf, 1, 1, 1, 1, 1}, 4);
+        CHECK(withInf[1] == inf);
+        CHECK(withInf[4] == inf);
+        CHECK(withInf[5] == 1);
+        CHECK(withInf[6] == 1);
+        
+        auto mixed = meanOf({inf, -inf, 2, 4, 6}, 2);
+        CHECK(mixed[0] == inf);
+        CHECK(std::isnan(mixed[1]));
+        CHECK(mixed[2] == -inf);
+        CHECK(mixed[3] == 3);
+        CHECK(mixed[4] == 5);
+    }
+    
+    SECTION("Division by zero inside a window") {
+        // Значение 1 / 0 остается помеченным, пока оно в окне, даже если if отбросил строку, где оно появилось
+        auto rpn = parser.parseToRPN(lexer.tokenize("if(x == 0, 0, rolling_mean(1 / x, 2))"));
+        std::vector<double> series = {1, 0, 1, 1};
+        
+        Evaluator eval;
+        eval.setVariable("x", 1);
+        CHECK(eval.evaluateRPN(rpn) == 1);
+        eval.setVariable("x", 0);
+        CHECK(eval.evaluateRPN(rpn) == 0);
+        eval.setVariable("x", 1);
+        REQUIRE_THROWS_AS(eval.evaluateRPN(rpn), MathError);
+        CHECK(eval.evaluateRPN(rpn) == 1);
+        
+        BatchEvaluator batch;
+        std::vector<double> out(series.size());
+        batch.setColumn("x", series.data());
+        REQUIRE_THROWS_AS(batch.evaluateRPN(rpn, series.size(), out.data()), MathError);
+        
+        batch.resetState();
+        batch.evaluateRPN(rpn, 2, out.data());
+        CHECK(out[1] == 0);
+        batch.setColumn("x", series.data() + 2);
+        REQUIRE_THROWS_AS(batch.evaluateRPN(rpn, 1, out.data()), MathError);
+        batch.setColumn("x", series.data() + 3);
+        batch.evaluateRPN(rpn, 1, out.data());
+        CHECK(out[0] == 1);
+    }
+    
+    SECTION("Errors") {
+        Evaluator eval;
+        eval.setVariable("x", 1);
+        REQUIRE_THROWS_AS(eval.evaluateRPN(parser.parseToRPN(lexer.tokenize("rolling_mean(x, 0)"))), MathError);
+        REQUIRE_THROWS_AS(eval.evaluateRPN(parser.parseToRPN(lexer.tokenize("rolling_max(x, 2.5)"))), MathError);
+        REQUIRE_THROWS_AS(eval.evaluateRPN(parser.parseToRPN(lexer.tokenize("ema(x, 2)"))), MathError);
+        // Буфер окна выделяется сразу: огромное окно - ошибка, а не bad_alloc
+        REQUIRE_THROWS_AS(eval.evaluateRPN(parser.parseToRPN(lexer.tokenize("rolling_mean(x, 100000000000)"))), MathError);
+        
+        BatchEvaluator batch;
+        batch.setColumn("x", x.data());
+        std::vector<double> out(rows);
+        REQUIRE_THROWS_AS(batch.evaluateRPN(parser.parseToRPN(lexer.tokenize("lag(x, x)")), rows, out.data()), RuntimeError);
+        
+        // Параметр - одно число или переменная и не меняется посреди ряда
+        auto lagN = parser.parseToRPN(lexer.tokenize("lag(x, n)"));
+        REQUIRE_THROWS_AS(eval.evaluateRPN(parser.parseToRPN(lexer.tokenize("lag(x, 1 + 1)"))), RuntimeError);
+        eval.setVariable("n", 1);
+        eval.evaluateRPN(lagN);
+        eval.setVariable("n", 2);
+        REQUIRE_THROWS_AS(eval.evaluateRPN(lagN), RuntimeError);
+        eval.resetState();
+        CHECK(std::isnan(eval.evaluateRPN(lagN)));
+        
+        Evaluator selfLag;
+        auto lagX = parser.parseToRPN(lexer.tokenize("lag(x, x)"));
+        selfLag.setVariable("x", 1);
+        selfLag.evaluateRPN(lagX);
+        selfLag.setVariable("x", 2);
+        REQUIRE_THROWS_AS(selfLag.evaluateRPN(lagX), RuntimeError);
+        
+        batch.setVariable("n", 1);
+        batch.evaluateRPN(lagN, rows, out.data());
+        batch.setVariable("n", 2);
+        REQUIRE_THROWS_AS(batch.evaluateRPN(lagN, rows, out.data()), RuntimeError);
+    }
+}
+
+TEST_CASE("Guarded division", "[evaluator][batch][static]") {
+    Lexer lexer;
+    Parser parser;
+    
+    // Деление на ноль в ветви, отброшенной if, не является ошибкой ни в одном режиме
+    const std::string guarded = "if(x == 0, 0, y / x)";
+    const std::string unguarded = "if(x == 0, y / x, 0)";
+    std::vector<double> x = {2, 0, -4, 0, 1};
+    std::vector<double> y = {1, 5, 2, 7, 3};
+    
+    SECTION("Evaluator") {
+        Evaluator eval;
+        eval.setVariable("y", 6);
+        eval.setVariable("x", 0);
+        CHECK(eval.evaluateRPN(parser.parseToRPN(lexer.tokenize(guarded))) == 0);
+        REQUIRE_THROWS_AS(eval.evaluateRPN(parser.parseToRPN(lexer.tokenize(unguarded))), MathError);
+        eval.setVariable("x", 3);
+        CHECK(eval.evaluateRPN(parser.parseToRPN(lexer.tokenize(guarded))) == 2);
+    }
+    
+    SECTION("BatchEvaluator") {
+        BatchEvaluator batch;
+        batch.setColumn("x", x.data());
+        batch.setColumn("y", y.data());
+        
+        std::vector<double> out(x.size());
+        batch.evaluateRPN(parser.parseToRPN(lexer.tokenize(guarded)), x.size(), out.data());
+        CHECK(out == std::vector<double>{0.5, 0, -0.5, 0, 3});
+        
+        Accumulator acc(ReduceSpec::parse("sum"));
+        batch.reduceRPN(parser.parseToRPN(lexer.tokenize(guarded)), x.size(), acc, 2);
+        CHECK(acc.sum() == 3);
+        
+        REQUIRE_THROWS_AS(batch.evaluateRPN(parser.parseToRPN(lexer.tokenize(unguarded)), x.size(), out.data()), MathError);
+        REQUIRE_THROWS_AS(batch.evaluateRPN(parser.parseToRPN(lexer.tokenize("y / x")), x.size(), out.data()), MathError);
+    }
+    
+    SECTION("CALC_STATIC_EXPR") {
+        constexpr auto f = CALC_STATIC_EXPR("if(x == 0, 0, y / x)");
+        constexpr auto g = CALC_STATIC_EXPR("if(x == 0, y / x, 0)");
+        for (size_t i = 0; i < x.size(); ++i) {
+            CHECK(f(x[i], y[i]) == (x[i] == 0 ? 0 : y[i] / x[i]));
+        }
+        REQUIRE_THROWS_AS(g(0, 1), MathError);
+        CHECK(g(2, 1) == 0);
+    }
+}